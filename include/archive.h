@@ -0,0 +1,67 @@
+#ifndef _XVM_ARCHIVE_H_
+#define _XVM_ARCHIVE_H_ 1
+
+#include <xvm/executable.h>
+
+#include <unordered_map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define XVM_ARCHIVE_MAGIC 0x72617678 // "xvar"
+
+namespace xvm {
+
+/*
+Archive format:
+0-4     u32  MAGIC
+4-8     u32  VERSION
+8-12    u32  MEMBER_COUNT
+12-16   u32  SYMBOL_COUNT
+16-.    *    MEMBERS (MEMBER_COUNT entries)
+.       *    SYMBOL INDEX (SYMBOL_COUNT entries)
+.       *    MEMBER DATA (executables, each aligned to 16)
+
+Member:
+0-4     u32  DATA OFFSET (from the beginning of file)
+4-8     u32  DATA SIZE
+8-N     str  NAME (ends with '\0')
+
+Symbol index entry:
+0-4     u32  MEMBER
+4-N     str  LABEL (ends with '\0')
+
+Index holds exported symbols of every member, so the linker can find
+members it needs without decoding their symbol tables
+*/
+struct Archive {
+  struct Member {
+    std::string name;
+    Executable object;
+  };
+
+  u32 magic = XVM_BAD_MAGIC;
+  u32 version = 0;
+  std::vector<Member> members;
+  std::unordered_map<std::string, u32> index; // Label -> member
+
+  // Keeps the buffer member sections point into alive
+  std::shared_ptr<const u8> backing;
+
+ public:
+  bool addMember(const std::string& name, const Executable& object);
+
+  // Member exporting label, nullptr if none
+  const Member* findMember(const std::string& label) const;
+
+  std::vector<u8> toBytes() const;
+  void toFile(const std::string& filename) const;
+
+  static bool isArchive(const std::string& filename);
+  static Archive fromBuffer(const u8* data, size_t size);
+  static Archive fromFile(const std::string& filename);
+};
+
+} /* namespace xvm */
+
+#endif /* _XVM_ARCHIVE_H_ */
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <unordered_map>
 #include <string_view>
+#include <deque>
 #include <stdexcept>
 #include <charconv>
 #include <cstdint>
@@ -31,19 +32,38 @@ enum class TokenType : uint8_t {
   STAR,
 };
 
+// Text is a view into a SourceArena of the assembler that made the token
 struct Token {
   TokenType type;
-  std::string str;
+  std::string_view str;
   int line;
 
   Token();
-  Token(TokenType type, std::string str, int line);
+  Token(TokenType type, std::string_view str, int line);
   Token(TokenType type, const char* str, size_t length, int line);
 
   bool operator==(const Token& t) const;
-  bool operator==(const std::string& s) const;
+  bool operator==(std::string_view s) const;
 
-  i32 toNumber();
+  i32 toNumber(bool negate = false) const;
+};
+
+/*
+Owns sources of the assembled file and of everything it includes, and text
+that isn't in any source (unescaped strings, command line defines). Buffers
+never move, so tokens, labels and defines can all be views into them for
+the whole assembly instead of owning copies
+*/
+class SourceArena {
+ private:
+  std::deque<std::string> m_buffers;
+
+ public:
+  SourceArena() = default;
+  SourceArena(const SourceArena&) = delete;
+  SourceArena& operator=(const SourceArena&) = delete;
+
+  std::string_view add(std::string text);
 };
 
 struct LabelMention {
@@ -52,8 +72,9 @@ struct LabelMention {
 };
 
 struct Label {
-  int32_t address = -1;
+  int32_t address = -1; // Offset from section start until layoutSections
   bool isProcedure = false;
+  SectionType section = SectionType::CODE;
   std::vector<LabelMention> mentions;
 };
 
@@ -75,33 +96,42 @@ struct Variable {
   std::vector<Mention> mentions;
 
   int size() const;
+  int elementSize() const;
 
-  static Type stringToType(const std::string& type);
+  static Type stringToType(std::string_view type);
   static std::string typeToString(Type type);
 };
 
 class Assembler {
  private:
   std::string m_filename;
-  std::string m_source;
+  SourceArena m_arena;
+  std::string_view m_source; // In m_arena
   std::vector<Token> m_tokens;
 
   std::vector<std::string> m_includeFolders;
   std::vector<std::string> m_included;
 
   std::vector<u8> m_code;
-  std::unordered_map<std::string, Label> m_labels;
-  std::unordered_map<std::string, Variable> m_variables;
-  std::unordered_map<std::string, int> m_syscalls;
-  std::unordered_map<std::string, std::vector<Token>> m_defines;
-
-  std::vector<std::string> m_exported;
-  std::vector<std::string> m_externs;
+  std::vector<u8> m_data;
+  u32 m_bssSize = 0;
+  // Keys are views into m_arena
+  std::unordered_map<std::string_view, Label> m_labels;
+  std::unordered_map<std::string_view, Variable> m_variables;
+  std::unordered_map<std::string_view, int> m_syscalls;
+  std::unordered_map<std::string_view, std::vector<Token>> m_defines;
+  std::unordered_map<std::string_view, int> m_frameSlots;
+
+  std::vector<std::string_view> m_exported;
+  std::vector<std::string_view> m_externs;
   bool m_exportAll = false;
 
   const char* m_start = nullptr;
   const char* m_current = nullptr;
 
+  i32 m_lastOpcode = -1;
+  i32 m_lastLabel = -1;
+
   bool m_hadError = false;
   int m_line = 1;
   int m_index = 0;
@@ -116,10 +146,11 @@ class Assembler {
 
   void includeFile(const std::string& filename);
 
+  // Key and text of value are copied into the arena
   void define(const std::string& key, const std::vector<Token>& value);
-  void undef(const std::string& key);
-  bool isDefined(const std::string& key);
-  std::vector<Token>& getDefined(const std::string& key);
+  void undef(std::string_view key);
+  bool isDefined(std::string_view key);
+  std::vector<Token>& getDefined(std::string_view key);
 
  private:
   void asmNote(const char* fmt, ...);
@@ -128,13 +159,16 @@ class Assembler {
   void asmError(const Token& t, const char* fmt, ...);
 
   void tokenize();
+  void tokenize(std::string_view source, std::vector<Token>& tokens);
   void parse();
+  void layoutSections();
   void patchLabels();
   void patchVariables();
-  void patchAddressingMode(i32 labelAddress, i32 mentionAddress, u8 argumentNumber);
 
   // int32_t getAddress(u8 arg, i32 flagsOffset); // ???
   int32_t getAddress(u8 argumentNumber = 1);
+  int32_t getFrameSlot();
+  int32_t getCount();
   Token getNextToken();
 
   void skipWhitespace();
@@ -149,10 +183,13 @@ class Assembler {
   void define();
   void undef();
 
+  bool tryTailCall();
+
   void pushOpcode(abi::OpCode opcode, abi::AddressingMode mode1, abi::AddressingMode mode2 = abi::_NONE);
   void pushByte(uint8_t value);
   void pushInt16(int16_t value);
   void pushInt32(int32_t value);
+  void pushData(Variable::Type type, int32_t value);
 };
 
 } /* namespace xvm */
@@ -29,8 +29,6 @@ class Bus {
     Device* device = nullptr;
     bool destroy = false;
 
-    ~Dev();
-
     bool check(size_t address) const;
   };
 
@@ -45,7 +43,10 @@ class Bus {
   uint8_t read(size_t address) const;
   void write(size_t address, uint8_t value);
 
-  void bind(size_t address, size_t length, bus::Device* dev, bool destroy = false);
+  bool bind(size_t address, size_t length, bus::Device* dev, bool destroy = false);
+  void overlay(size_t address, size_t length, bus::Device* dev, bool destroy = false);
+  void unbind(bus::Device* dev);
+  bool resize(bus::Device* dev, size_t length);
 
   Device* getDevice(size_t index) const;
   Device* getDeviceByAddress(size_t address) const;
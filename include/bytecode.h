@@ -46,7 +46,13 @@ enum OpCode : u8 {
   JUMPF,    //
   CALL,     //
   SYSCALL,  //
-  RET
+  RET,
+  ENTER,
+  LEAVE,
+  LOADL,
+  STOREL,
+  PICK,
+  TAILCALL
 };
 
 enum AddressingMode : u8 {
@@ -67,6 +73,15 @@ AddressingMode extractModeArg1(u8 flags);
 AddressingMode extractModeArg2(u8 flags);
 void decodeIntstruction(const Intstruction instruction, AddressingMode& mode1, AddressingMode& mode2, OpCode& opcode);
 
+// Address referenced by instruction argument stored at code[mention]
+i32 decodeAddress(const u8* code, i32 mention, u8 argumentNumber);
+// Stores address into instruction argument at code[mention],
+// as a relative offset (PRO/NRO) if pic is set or as is otherwise
+void encodeAddress(u8* code, i32 address, i32 mention, u8 argumentNumber, bool pic);
+
+// Length in bytes of instruction at code[offset], as it is read by the VM
+int instructionSize(const u8* code, int offset = 0);
+
 int disassembleInstruction(const uint8_t* data, int offset = 0);
 
 } /* namespace abi */
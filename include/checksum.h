@@ -0,0 +1,19 @@
+#ifndef _XVM_CHECKSUM_H_
+#define _XVM_CHECKSUM_H_ 1
+
+#include <xvm/abi.h>
+
+#include <cstddef>
+
+namespace xvm {
+
+/*
+CRC32C (Castagnoli). Uses the SSE4.2 crc32 instruction when the CPU has
+it and a slice-by-8 table otherwise, both give the same result.
+Pass the previous result as crc to checksum data in several chunks
+*/
+u32 crc32c(const u8* data, size_t length, u32 crc = 0);
+
+} /* namespace xvm */
+
+#endif
\ No newline at end of file
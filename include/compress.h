@@ -0,0 +1,34 @@
+#ifndef _XVM_COMPRESS_H_
+#define _XVM_COMPRESS_H_ 1
+
+#include <xvm/abi.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace xvm {
+namespace lz {
+
+/*
+Byte oriented LZ77 codec (LZ4 like block layout), favours decompression
+speed over ratio. Stream is a sequence of:
+  u8   TOKEN (high nibble: literal count, low nibble: match length - 4)
+  u8*  LITERAL COUNT EXTENSION (if literal count is 15, sum of bytes up to first non-255 byte)
+  *    LITERALS
+  u16  MATCH OFFSET (backwards from current output position)
+  u8*  MATCH LENGTH EXTENSION (same as literal count extension)
+Last sequence has only literals
+*/
+std::vector<u8> compress(const u8* data, size_t length);
+
+// Decompressed data can't be larger than this many bytes per stream byte
+// (a match token with length extensions of 255)
+#define XVM_LZ_MAX_RATIO 255
+
+// Decompresses into dst, which must have exactly the size of the original data
+bool decompress(const u8* data, size_t length, u8* dst, size_t dstLength);
+
+} /* namespace lz */
+} /* namespace xvm */
+
+#endif
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef _XVM_DEVICES_DMA_H_
+#define _XVM_DEVICES_DMA_H_ 1
+
+#include <xvm/bus.h>
+#include <xvm/abi.h>
+
+#include <atomic>
+#include <thread>
+
+
+#define XVM_BUS_DEV_DMA_NAME "dma"
+
+#define XVM_DMA_SRC_REGISTER      0   // u32
+#define XVM_DMA_DST_REGISTER      4   // u32
+#define XVM_DMA_LEN_REGISTER      8   // u32
+#define XVM_DMA_CONTROL_REGISTER  12  // u8
+#define XVM_DMA_STATUS_REGISTER   13  // u8
+#define XVM_DMA_REGISTERS_SIZE    16
+
+#define XVM_DMA_CONTROL_START     1
+
+#define XVM_DMA_STATUS_BUSY       1
+#define XVM_DMA_STATUS_DONE       2
+#define XVM_DMA_STATUS_ERROR      4
+
+
+namespace xvm {
+namespace bus {
+namespace device {
+
+/*
+Copies LEN bytes from SRC to DST on a host thread, so the guest can keep
+running while the transfer is in flight. Transfer is started by writing
+START into control register, completion is reported in status register.
+Worker looks devices up on the bus, so anything that binds, unbinds or
+resizes devices while the guest runs has to wait for the transfer first
+*/
+class DMA : public Device {
+ private:
+  Bus* m_bus = nullptr;
+  size_t m_baseAddr = 0;
+
+  abi::N32 m_src;
+  abi::N32 m_dst;
+  abi::N32 m_len;
+  std::atomic<uint8_t> m_status {0};
+
+  std::thread m_worker;
+
+ public:
+  DMA(Bus* bus);
+  ~DMA();
+
+  void initialize(size_t base);
+
+  void start();
+  void wait();
+
+  uint8_t read(size_t address) override;
+  void write(size_t address, uint8_t value) override;
+
+ private:
+  void transfer(u32 src, u32 dst, u32 len);
+};
+
+} /* namespace device */
+} /* namespace bus */
+} /* namespace xvm */
+
+#endif
\ No newline at end of file
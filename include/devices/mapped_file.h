@@ -0,0 +1,42 @@
+#ifndef _XVM_DEVICES_MAPPED_FILE_H_
+#define _XVM_DEVICES_MAPPED_FILE_H_ 1
+
+#include <xvm/bus.h>
+
+#include <string>
+
+#define XVM_BUS_DEV_MAPPED_FILE_NAME "file"
+
+namespace xvm {
+namespace bus {
+namespace device {
+
+/*
+Host file mapped into guest address space, reads and writes go straight
+to the page cache. Read-only mappings ignore writes
+*/
+class MappedFile : public Device {
+ private:
+  uint8_t* m_buffer = nullptr;
+  size_t m_size = 0;
+  size_t m_baseAddr;
+  bool m_writable;
+
+ public:
+  MappedFile(const std::string& filename, size_t base, bool writable);
+  ~MappedFile();
+
+  bool isOpen() const;
+  bool isWritable() const;
+
+  size_t getSize();
+  uint8_t* getBuffer();
+  uint8_t read(size_t address) override;
+  void write(size_t address, uint8_t value) override;
+};
+
+} /* namespace device */
+} /* namespace bus */
+} /* namespace xvm */
+
+#endif
\ No newline at end of file
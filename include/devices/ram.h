@@ -5,21 +5,36 @@
 
 #define XVM_BUS_DEV_RAM_NAME "ram"
 
+#define XVM_RAM_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
 namespace xvm {
 namespace bus {
 namespace device {
 
+/*
+Address space for maxSize bytes is reserved up front and only the first
+size bytes are accessible, so resize never moves or copies the buffer.
+The reservation isn't charged against the commit limit and pages are
+zero-filled by the OS on first touch, so an untouched RAM costs nothing
+*/
 class RAM : public Device {
  private:
   uint8_t* m_buffer = nullptr;
   size_t m_size;
+  size_t m_maxSize;
   size_t m_baseAddr;
+  bool m_valid = false;
 
  public:
-  RAM(size_t size, size_t base);
+  RAM(size_t size, size_t base, size_t maxSize = 0, bool hugePages = false);
   ~RAM();
 
+  bool resize(size_t size);
+  // False when the reservation or the initial size couldn't be mapped
+  bool isValid() const;
+
   size_t getSize();
+  size_t getMaxSize();
   uint8_t* getBuffer();
   uint8_t read(size_t address) override;
   void write(size_t address, uint8_t value) override;
@@ -0,0 +1,53 @@
+#ifndef _XVM_DEVICES_ROM_H_
+#define _XVM_DEVICES_ROM_H_ 1
+
+#include <xvm/bus.h>
+
+#include <functional>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define XVM_BUS_DEV_ROM_NAME "rom"
+
+namespace xvm {
+namespace bus {
+namespace device {
+
+/*
+Immutable image shared by every VM in the process that loads the same
+contents. Images are deduplicated by content and released once the last
+ROM referencing them is destroyed. Writes are rejected and reported to the
+write handler, the VM owning the ROM stops there
+*/
+class ROM : public Device {
+ public:
+  using Image = std::shared_ptr<const std::vector<uint8_t>>;
+  using WriteHandler = std::function<void(size_t address)>;
+
+ private:
+  Image m_image;
+  size_t m_baseAddr;
+  WriteHandler m_onWrite;
+
+ public:
+  ROM(const uint8_t* data, size_t size, size_t base);
+  ROM(Image image, size_t base);
+
+  size_t getSize() const;
+  const uint8_t* getBuffer() const;
+  const Image& getImage() const;
+
+  void setWriteHandler(WriteHandler handler);
+
+  uint8_t read(size_t address) override;
+  void write(size_t address, uint8_t value) override;
+
+  static Image share(const uint8_t* data, size_t size);
+};
+
+} /* namespace device */
+} /* namespace bus */
+} /* namespace xvm */
+
+#endif
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef _XVM_DYNAMIC_H_
+#define _XVM_DYNAMIC_H_ 1
+
+#include <xvm/abi.h>
+#include <xvm/executable.h>
+
+#include <unordered_map>
+#include <string>
+#include <vector>
+
+// Libraries are mapped above the largest RAM, one after another
+#define XVM_DYNAMIC_BASE      0x40000000
+#define XVM_DYNAMIC_ALIGN     4096
+// push IMM index; syscall IMM dl_resolve
+#define XVM_DYNAMIC_STUB_SIZE 12
+
+namespace xvm {
+
+class VM;
+
+/*
+Every import gets a stub at the end of program code, mentions of the import
+point at it. On first call the stub asks the dynamic linker for the import's
+address and gets overwritten with a jump there, later calls go straight into
+the library. Stubs in ROM can't be patched and resolve on every call.
+Library code is mapped as ROM shared by every VM loading it, data and bss
+get a RAM of their own per VM. Libraries have to be linked with pic set,
+since they aren't relocated
+*/
+class DynamicLinker {
+ private:
+  struct Library {
+    std::string filename;
+    u32 base;
+  };
+
+  RunInfo m_runInfo;
+  std::vector<Library> m_libraries;
+  std::unordered_map<std::string, i32> m_exports;
+  std::vector<i32> m_resolved; // Per import, -1 until resolved
+
+ public:
+  int load(VM& vm, const RunInfo& runInfo);
+
+  // Address of the import, -1 if no library exports it
+  i32 resolve(VM& vm, u32 index);
+
+  static void encodeStub(u8* code, u32 index);
+};
+
+} /* namespace xvm */
+
+#endif /* _XVM_DYNAMIC_H_ */
\ No newline at end of file
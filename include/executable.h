@@ -1,7 +1,9 @@
 #ifndef _XVM_EXECUTABLE_H_
 #define _XVM_EXECUTABLE_H_ 1
 
+#include <unordered_map>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 #include <xvm/abi.h>
@@ -10,10 +12,18 @@
 #define XVM_SECTION_MAGIC 0xdeadbeef
 #define XVM_BAD_MAGIC -1U
 
+#define XVM_FORMAT_V1 1
+#define XVM_FORMAT_V2 2
+
+#define XVM_EXE_HEADER_SIZE     32
+#define XVM_EXE_DIR_ENTRY_SIZE  32
+#define XVM_EXE_SECTION_ALIGN   4096
+#define XVM_SECTION_MEMORY_ALIGN 16 // In memory, for data and bss of each object
+
 namespace xvm {
 
 /*
-Executable format:
+Executable format v1:
 0-4     u32  MAGIC
 4-8     u32  VERSION
 8-12    u32  FLAGS
@@ -24,18 +34,54 @@ Section:
 0-N     str  LABEL (ends with '\0')
 N+4     u32  TYPE
 N+8     u32  DATA SIZE
-N+12    u32  RESERVED (checksum)
+N+12    u32  CHECKSUM
 N+16    *    DATA
+
+Executable format v2 (FLAGS has ExecutableFlags::DIRECTORY set):
+0-4     u32  MAGIC
+4-8     u32  VERSION
+8-12    u32  FLAGS
+12-16   u32  SECTION_COUNT
+16-20   u32  FORMAT
+20-24   u32  DIRECTORY OFFSET
+24-28   u32  SECTION ALIGNMENT
+28-32   u32  RESERVED
+32-.    *    DIRECTORY (SECTION_COUNT entries)
+.       *    STRING TABLE (section labels, each ends with '\0')
+.       *    SECTION DATA (each aligned to SECTION ALIGNMENT)
+
+Directory entry:
+0-4     u32  TYPE
+4-8     u32  FLAGS (SectionFlags)
+8-12    u32  ADDR
+12-16   u32  DATA OFFSET (from the beginning of file)
+16-20   u32  DATA SIZE (as stored)
+20-24   u32  CHECKSUM (of data as stored)
+24-28   u32  LABEL OFFSET (from the beginning of string table)
+28-32   u32  RAW SIZE (size of decompressed data)
+
+Sections are page aligned, so a reader can map or seek to one section
+without touching the others
 */
 
 enum class SectionType : u32 {
   CODE        = 1,
-  DATA        = 2, // ?
+  DATA        = 2,
   SYMBOLS     = 3,
   RELOCATIONS = 4,
   RUNINFO     = 5,
-  // TODO: runinfo or some other section has to have a list of
-  // dynamic mlibraries to be linked before execution (stdlib, etc)
+  BSS         = 6, // Zero-initialized, only its size is stored
+  OBJECTS     = 7, // Which object linked code came from, see ObjectTable
+};
+
+enum class ExecutableFlags : u32 {
+  DIRECTORY = 0x1,
+  CHECKSUMS = 0x2, // Section checksums are CRC32C of section data
+  PIC       = 0x4, // Linked with pic, code runs at any base (dynamic libraries need it)
+};
+
+enum class SectionFlags : u32 {
+  COMPRESSED = 0x1, // Data is compressed with lz::compress
 };
 
 enum class SymbolFlags : u32 {
@@ -44,22 +90,52 @@ enum class SymbolFlags : u32 {
   VARIABLE  = 0x4,
   ENTRY     = 0x8,
   EXTERN    = 0x10,
+  LOCAL     = 0x20, // Not exported, only used to relocate the object's own mentions
+  BSS       = 0x40, // Address is in bss section
+  DATA      = 0x80, // Address is in data section
 };
 
 struct Executable {
   struct Section {
-    u32 magic;
+    u32 magic = XVM_SECTION_MAGIC;
     SectionType type;
-    u32 addr;
-    u32 checksum;
+    u32 flags = 0;
+    u32 addr = -1U;
+    u32 checksum = 0;
     std::string label;
     std::vector<u8> data;
 
+    // Non-owning view into the buffer the section was read from, used
+    // instead of data when set. See Executable::fromFile
+    const u8* view = nullptr;
+    size_t viewSize = 0;
+
+    // Size of view contents once decompressed (size of reserved memory
+    // for bss), and the decompressed contents themselves. Filled by
+    // inflate(), never lazily, so sections can be shared between threads
+    size_t rawSize = 0;
+    std::vector<u8> inflated;
+
    public:
     Section() = default;
     Section(SectionType type, std::string label, std::vector<u8> data, u32 addr = -1U);
 
+    bool isCompressed() const;
+
+    const u8* bytes() const;
+    size_t length() const;
     size_t size() const;
+    size_t memoryLength() const;
+
+    const u8* storedBytes() const;
+    size_t storedLength() const;
+
+    // bytes() of a compressed section is only valid after inflate()
+    bool inflate();
+    bool unpack(u8* destination) const;
+
+    u32 computeChecksum() const;
+    bool verifyChecksum() const;
 
     std::vector<u8> toBytes() const;
     static Section fromBuffer(const u8* data, size_t offset);
@@ -71,8 +147,12 @@ struct Executable {
   u32 magic = XVM_BAD_MAGIC;
   u32 version = 0;
   u32 flags = 0;
+  u32 format = XVM_FORMAT_V2;
   std::vector<Section> sections;
 
+  // Keeps the buffer section views point into alive
+  std::shared_ptr<const u8> backing;
+
  public:
   bool hasSection(const std::string& label) const;
   Section& getSection(const std::string& label);
@@ -83,8 +163,9 @@ struct Executable {
   std::vector<u8> toBytes() const;
   void toFile(const std::string& filename) const;
 
-  static Executable fromBuffer(const u8* data);
-  static Executable fromFile(const std::string& filename);
+  // Without inflate, compressed sections are left as they are stored
+  static Executable fromBuffer(const u8* data, size_t size, bool inflate = true);
+  static Executable fromFile(const std::string& filename, bool inflate = true);
 };
 
 // Special Sections
@@ -100,6 +181,9 @@ struct SymbolTable {
     bool isProcedure() const;
     bool isVariable() const;
     bool isExtern() const;
+    bool isLocal() const;
+    bool isBss() const;
+    bool isData() const;
 
     std::vector<std::string> getStringLine() const;
     static const std::vector<std::string> getFieldNames();
@@ -107,14 +191,33 @@ struct SymbolTable {
 
   std::vector<Symbol> symbols;
 
+ private:
+  // Built on first lookup and rebuilt whenever symbols changes size.
+  // Call reindex after changing symbols in place (sorting, editing)
+  mutable std::unordered_map<std::string, size_t> m_labelIndex;
+  mutable std::vector<size_t> m_addressIndex; // Sorted by address
+  mutable size_t m_indexedSize = -1UL;
+
+ public:
   void addSymbol(i32 address, const std::string& label, u16 flags = (u16)SymbolFlags::LABEL, u16 data_width = 0);
 
+  // First symbol added with given address/label, nullptr if none
+  Symbol* findByAddress(i32 address);
+  Symbol* findByLabel(const std::string& label);
+  const Symbol* findByAddress(i32 address) const;
+  const Symbol* findByLabel(const std::string& label) const;
+
+  // Symbol with the highest address not above given one, nullptr if none
+  const Symbol* findNearest(i32 address) const;
+
   Symbol& getByAddress(i32 address);
   Symbol& getByLabel(const std::string& label);
 
   bool hasAddress(i32 address) const;
   bool hasLabel(const std::string& label) const;
 
+  void reindex() const;
+
   Executable::Section toSection(const std::string& label = "symbols") const;
 
   static SymbolTable fromSection(const Executable::Section& section);
@@ -138,6 +241,53 @@ struct RelocationTable {
   static RelocationTable fromSection(const Executable::Section& section);
 };
 
+/*
+Dynamic libraries to load before execution and imports from them (see
+DynamicLinker):
+0-4     u32  LIBRARY COUNT
+        ...  LIBRARY FILENAME, null terminated, for every library
+        u32  IMPORT COUNT
+        ...  u32 STUB ADDRESS, LABEL null terminated, for every import
+*/
+struct RunInfo {
+  struct Import {
+    u32 stub;
+    std::string label;
+  };
+
+  std::vector<std::string> libraries;
+  std::vector<Import> imports;
+
+  Executable::Section toSection(const std::string& label = "runinfo") const;
+
+  static RunInfo fromSection(const Executable::Section& section);
+};
+
+/*
+Where code of every linked object starts, so addresses in linked output can
+be traced back to the object they came from (profile keeps LOCAL labels of
+different objects apart with it, see Profiler):
+0-4     u32  OBJECT COUNT
+        ...  u32 CODE BEGIN, u32 OBJECT HASH (LinkCache::objectHash) for
+             every run of code from one object, ordered by CODE BEGIN. An
+             object has several runs when link-profile laid out its code
+*/
+struct ObjectTable {
+  struct Object {
+    u32 codeBegin;
+    u32 hash;
+  };
+
+  std::vector<Object> objects;
+
+  Executable::Section toSection(const std::string& label = "objects") const;
+
+  // Hash of the object code at address came from, 0 if unknown
+  u32 findHash(u32 address) const;
+
+  static ObjectTable fromSection(const Executable::Section& section);
+};
+
 std::string sectionTypeToString(SectionType type);
 
 } /* namespace xvm */
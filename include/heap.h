@@ -0,0 +1,54 @@
+#ifndef _XVM_HEAP_H_
+#define _XVM_HEAP_H_ 1
+
+#include <xvm/abi.h>
+
+#include <unordered_map>
+#include <vector>
+#include <map>
+
+#define XVM_HEAP_MIN_CLASS_SHIFT 4    // Smallest block is 16 bytes
+#define XVM_HEAP_CLASS_COUNT     8    // Largest size class is 2048 bytes
+#define XVM_HEAP_LARGE_ALIGN     4096 // Bigger blocks are rounded to this
+
+namespace xvm {
+
+/*
+Allocator for a region of guest memory.
+Small blocks are served from segregated free lists, one per power of two
+size class, large blocks from a best-fit list of page sized runs. Freed
+runs are merged with free neighbours and given back to the top. All
+metadata lives on the host, so guest code can't corrupt it and free/realloc
+never touch guest memory to find a block.
+*/
+class Heap {
+ private:
+  u32 m_begin = 0;
+  u32 m_end = 0;
+  u32 m_top = 0;
+
+  std::vector<u32> m_freeLists[XVM_HEAP_CLASS_COUNT];
+  std::multimap<u32, u32> m_largeFree; // size -> address
+  std::map<u32, u32> m_largeFreeRuns; // address -> size, same runs for merging neighbours
+  std::unordered_map<u32, u32> m_blocks; // address -> size
+
+ public:
+  void initialize(u32 begin, u32 end);
+  void extend(u32 end);
+
+  u32 allocate(u32 size);
+  bool release(u32 address);
+  u32 getBlockSize(u32 address) const;
+
+  u32 getBegin() const;
+  u32 getEnd() const;
+
+ private:
+  u32 allocateFresh(u32 size);
+  void insertLargeFree(u32 address, u32 size);
+  void eraseLargeFree(u32 address, u32 size);
+};
+
+} /* namespace xvm */
+
+#endif
\ No newline at end of file
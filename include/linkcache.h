@@ -0,0 +1,69 @@
+#ifndef _XVM_LINKCACHE_H_
+#define _XVM_LINKCACHE_H_ 1
+
+#include <xvm/executable.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+#define XVM_LINKCACHE_MAGIC 0x6b6e6c78 // "xlnk"
+#define XVM_LINKCACHE_SLACK(size) ((size) / 4 + 64) // Room left after each object
+
+namespace xvm {
+
+/*
+State of the last incremental link, stored next to its output (see
+link-incremental). Keeps where every object was placed and how much room it
+has there, what every object exports and which mentions refer to another
+object's symbols, so an object can be replaced without touching the others.
+
+File format (all numbers are u32):
+MAGIC VERSION OPTIONS OUTPUT_HASH CODE_SIZE DATA_SIZE BSS_SIZE
+OBJECT_COUNT, then per object:
+  HASH CODE_OFFSET CODE_SLOT DATA_OFFSET DATA_SLOT BSS_OFFSET BSS_SLOT
+GLOBAL_COUNT, then per global:  OBJECT ADDRESS LABEL\0
+IMPORT_COUNT, then per import:  OBJECT ADDRESS ARGUMENT ADDEND LABEL\0
+*/
+struct LinkCache {
+  struct Object {
+    u32 hash = 0;
+    u32 codeOffset = 0, codeSlot = 0;
+    u32 dataOffset = 0, dataSlot = 0; // From output data start
+    u32 bssOffset = 0, bssSlot = 0;   // From output bss start
+  };
+
+  struct Global {
+    u32 object;
+    i32 address;
+  };
+
+  // Mention (in output) of another object's symbol
+  struct Import {
+    u32 object;
+    i32 address;
+    u8 argumentNumber;
+    i32 addend;
+    std::string label;
+  };
+
+  u32 options = 0;    // See optionsHash
+  u32 outputHash = 0; // CRC32C of output file
+  u32 codeSize = 0, dataSize = 0, bssSize = 0;
+  std::vector<Object> objects;
+  std::map<std::string, Global> globals;
+  std::vector<Import> imports;
+
+ public:
+  bool toFile(const std::string& filename) const;
+  static bool fromFile(const std::string& filename, LinkCache& cache);
+
+  // Identifies object by contents of its sections
+  static u32 objectHash(const Executable& object);
+  // Identifies options that change link output, and dynamic-libs contents
+  static u32 optionsHash();
+};
+
+} /* namespace xvm */
+
+#endif /* _XVM_LINKCACHE_H_ */
\ No newline at end of file
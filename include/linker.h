@@ -2,11 +2,20 @@
 #define _XVM_LINKER_H_ 1
 
 #include <xvm/executable.h>
+#include <xvm/archive.h>
+#include <string>
 #include <vector>
 
 namespace xvm {
 
 Executable link(const std::vector<Executable>& objects);
+Executable link(const std::vector<Executable>& objects, const std::vector<Archive>& archives);
+
+// Objects followed by archive members needed to resolve their externs
+std::vector<Executable> resolveArchives(const std::vector<Executable>& objects, const std::vector<Archive>& archives);
+
+// Links objects into filename, reusing previous output when possible
+bool linkIncremental(const std::vector<Executable>& objects, const std::string& filename);
 
 } /* namespace xvm */
 
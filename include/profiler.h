@@ -0,0 +1,61 @@
+#ifndef _XVM_PROFILER_H_
+#define _XVM_PROFILER_H_ 1
+
+#include <xvm/abi.h>
+#include <xvm/executable.h>
+#include <xvm/dynamic.h>
+
+#include <unordered_map>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace xvm {
+
+/*
+Counts instructions executed at every address.
+Profile is written as lines of "ADDRESS COUNT LABEL OBJECT", one per symbol
+that had any instruction executed, COUNT being the sum for all addresses
+between the symbol and the next one, OBJECT the hash of the object the symbol
+came from (0 when the executable has no objects section). Linker reads it
+back by label, and LOCAL labels by object and label, since different objects
+can have LOCAL labels of the same name, see link-profile.
+Dynamic library code isn't counted, it isn't laid out by the program's link
+*/
+class Profiler {
+ public:
+  struct Profile {
+    std::unordered_map<std::string, u64> byLabel;
+    std::map<std::pair<u32, std::string>, u64> byObject; // (object hash, label) -> count
+
+    inline bool empty() const {
+      return byLabel.empty();
+    }
+  };
+
+ private:
+  std::vector<u64> m_counts;
+  ObjectTable m_objects;
+
+ public:
+  inline void hit(size_t address) {
+    if (address >= XVM_DYNAMIC_BASE) {
+      return;
+    }
+    if (address >= m_counts.size()) {
+      m_counts.resize(std::max(address + 1, m_counts.size() * 2), 0);
+    }
+    m_counts[address]++;
+  }
+
+  void setObjects(const ObjectTable& objects);
+
+  bool write(const std::string& filename, const SymbolTable& symbols) const;
+
+  static Profile read(const std::string& filename);
+};
+
+} /* namespace xvm */
+
+#endif /* _XVM_PROFILER_H_ */
\ No newline at end of file
@@ -2,15 +2,74 @@
 #define _XVM_STACK_H_ 1
 
 #include <cstddef>
+#include <cstdint>
+#include <csetjmp>
 
-template <typename T, int N = 256>
+namespace xvm {
+
+/*
+Anonymous mapping surrounded by inaccessible guard pages.
+Pages are committed on first touch, so a region can be sized for the
+worst case and only costs what is actually used. Any access to a guard
+page is reported as a fault to the thread that armed a fault handler.
+*/
+class GuardedRegion {
+ public:
+  struct Fault {
+    const GuardedRegion* region = nullptr;
+    bool overflow = false;
+  };
+
+  // Armed by a thread to catch faults in the listed regions
+  struct FaultHandler {
+    sigjmp_buf* jump = nullptr;
+    const GuardedRegion* const* regions = nullptr;
+    size_t regionCount = 0;
+    FaultHandler* previous = nullptr;
+  };
+
+ private:
+  uint8_t* m_mapping = nullptr;
+  size_t m_mappingSize = 0;
+  uint8_t* m_begin = nullptr;
+  size_t m_size = 0;
+
+ public:
+  GuardedRegion(size_t size);
+  ~GuardedRegion();
+
+  GuardedRegion(const GuardedRegion&) = delete;
+  GuardedRegion& operator=(const GuardedRegion&) = delete;
+
+  // False when the mapping failed, the region must not be used then
+  bool isValid() const;
+  void* begin() const;
+  size_t size() const;
+
+  bool check(const void* address, bool& overflow) const;
+
+  // Arming nests, disarming restores the handler armed before (nested VM runs)
+  static void armFaultHandler(FaultHandler* handler);
+  static void disarmFaultHandler(FaultHandler* handler);
+  static Fault getLastFault();
+};
+
+} /* namespace xvm */
+
+/*
+Overflow and underflow are not checked on push/pop, they hit the guard
+pages of the backing region instead (see GuardedRegion)
+*/
+template <typename T>
 class Stack {
  private:
-  T m_stack[N];
+  xvm::GuardedRegion m_region;
+  T* m_stack = nullptr;
   T* m_stackTop = nullptr;
 
  public:
-  inline Stack() {
+  inline Stack(size_t capacity = 256) : m_region(capacity * sizeof(T)) {
+    m_stack = static_cast<T*>(m_region.begin());
     reset();
   }
 
@@ -24,19 +83,37 @@ class Stack {
     return m_stackTop-m_stack;
   }
 
+  inline size_t capacity() const {
+    return m_region.size() / sizeof(T);
+  }
+
+  inline const xvm::GuardedRegion& getRegion() const {
+    return m_region;
+  }
+
   inline void push(T value) {
-    // if (m_stackTop > m_stack + N) {}
     *m_stackTop++ = value;
   }
 
   inline T pop() {
-    // if (m_stackTop <= m_stack) {}
     return *(--m_stackTop);
   }
 
   inline T peek(int distance = 0) const {
     return m_stackTop[-1-distance];
   }
+
+  inline T get(size_t index) const {
+    return m_stack[index];
+  }
+
+  inline void set(size_t index, T value) {
+    m_stack[index] = value;
+  }
+
+  inline void resize(size_t size) {
+    m_stackTop = m_stack + size;
+  }
 };
 
 #endif
\ No newline at end of file
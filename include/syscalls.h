@@ -10,12 +10,19 @@
 #define VMX_SYSCALL_CLOSE           31    // [handle] -> []
 #define VMX_SYSCALL_READ            32    // [handle, buf, len] -> []
 #define VMX_SYSCALL_WRITE           33    // [handle, buf, len] -> []
+#define VMX_SYSCALL_MMAP            34    // [filename, mode, addr] -> [size]
+#define VMX_SYSCALL_MUNMAP          35    // [addr] -> []
+#define VMX_SYSCALL_MALLOC          40    // [size] -> [ptr]
+#define VMX_SYSCALL_FREE            41    // [ptr] -> []
+#define VMX_SYSCALL_REALLOC         42    // [ptr, size] -> [ptr]
 #define VMX_SYSCALL_SLEEP           50    // [ms] -> []
 #define VMX_SYSCALL_FSCTL           60    // [..., cmd] -> [...]
 #define VMX_SYSCALL_VMCTL           70    // [..., cmd] -> [...]
 #define VMX_SYSCALL_SYSCTL          80    // [..., cmd] -> [...]
 #define VMX_SYSCALL_BREAKPOINT      90    // [] -> []
 #define VMX_SYSCALL_INIT_VIDEO      100   // [width, heigth, mem] -> []
+#define VMX_SYSCALL_INIT_DMA        101   // [mem] -> []
+#define VMX_SYSCALL_DL_RESOLVE      102   // [import] -> [], jumps to the import
 
 #define VMX_SYSCALL_FS_CLOSE_ALL    0
 #define VMX_SYSCALL_FS_CREATE_FILE  1
@@ -27,8 +34,8 @@
 #define VMX_SYSCALL_FS_CHDIR        7
 #define VMX_SYSCALL_FS_PWD          8
 
-#define VMX_SYSCALL_VM_GET_RAM      1
-#define VMX_SYSCALL_VM_EXPAND_RAM   2
+#define VMX_SYSCALL_VM_GET_RAM      1     // [] -> [size]
+#define VMX_SYSCALL_VM_EXPAND_RAM   2     // [bytes] -> [new size or 0]
 // #define VMX_SYSCALL_VM_CREATE_RAM_DEVICE 4
 
 #define VMX_SYSCALL_FILE_MODE_RDONLY  1
@@ -50,13 +57,25 @@ void sys_open(VM*);
 void sys_close(VM*);
 void sys_read(VM*);
 void sys_write(VM*);
+void sys_mmap(VM*);
+void sys_munmap(VM*);
+
+void sys_malloc(VM*);
+void sys_free(VM*);
+void sys_realloc(VM*);
 
 void sys_sleep(VM*);
 
+void sys_vmctl(VM*);
+
 void sys_breakpoint(VM*);
 
 void sys_init_video(VM*);
 
+void sys_init_dma(VM*);
+
+void sys_dl_resolve(VM*);
+
 namespace utils {
 std::string busReadString(xvm::VM* vm, int32_t ptr);
 int getAddr(VM* vm, const std::string& str);
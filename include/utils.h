@@ -2,6 +2,7 @@
 #define _XVM_UTILS_H_ 1
 
 #include <algorithm>
+#include <functional>
 #include <vector>
 #include <string>
 
@@ -25,6 +26,10 @@ inline void printTable(const std::vector<std::string>& fields, std::vector<T>& v
   printTable(fields, lines);
 }
 
+// Calls fn(i) for every i in [0; count) on up to threads threads
+// (hardware concurrency if 0), returns once all calls are done
+void parallelFor(size_t count, const std::function<void(size_t)>& fn, size_t threads = 0);
+
 [[noreturn]] void die(int returnCode = 1);
 
 } /* namespace xvm */
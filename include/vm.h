@@ -3,14 +3,20 @@
 
 #include <xvm/abi.h>
 #include <xvm/bus.h>
+#include <xvm/heap.h>
 #include <xvm/stack.h>
 #include <xvm/executable.h>
 #include <xvm/bytecode.h>
+#include <xvm/profiler.h>
+#include <xvm/dynamic.h>
 #include <xvm/devices/ram.h>
+#include <xvm/devices/dma.h>
 #include <xvm/devices/video.h>
 
 #include <unordered_map>
 #include <functional>
+#include <atomic>
+#include <memory>
 #include <cstdint>
 #include <string>
 
@@ -18,6 +24,7 @@ namespace xvm {
 
 class VM {
   friend void sys_init_video(VM*);
+  friend void sys_init_dma(VM*);
 
  public:
   using StackType = int32_t;
@@ -32,11 +39,13 @@ class VM {
  private:
   bus::Bus m_bus;
   bus::device::RAM m_ram;
+  bus::device::DMA m_dma;
 #ifdef XVM_FEATURE_VIDEO
   bus::device::Video m_video;
 #endif /* XVM_FEATURE_VIDEO */
 
   size_t m_ip = 0;
+  size_t m_fp = 0;
 
   Stack<StackType> m_stack;
   Stack<CallStackType> m_callStack;
@@ -45,15 +54,24 @@ class VM {
 
   SymbolTable m_symbols;
 
-  bool m_running = false;
+  Heap m_heap;
+
+  std::unique_ptr<Profiler> m_profiler; // Only when 'profile' is set
+  std::unique_ptr<DynamicLinker> m_dynamicLinker; // Only when linked with dynamic libraries
+
+  std::atomic<bool> m_running {false}; // Stopped from device threads too (DMA into ROM)
 
  public:
   VM(size_t ramSize = 1024);
   ~VM();
 
+  // False when RAM or a stack could not be mapped, the VM must not run then
+  bool isReady() const;
+
   void loadRegion(size_t address, const uint8_t* data, size_t length);
   void printRegion(size_t start, size_t length);
   void loadSymbols(const SymbolTable& table);
+  void loadObjects(const ObjectTable& table);
 
   void run();
   void stop();
@@ -66,8 +84,13 @@ class VM {
   void registerSyscall(int32_t number, const std::string& name, SyscallType fn);
 
   bus::Bus& getBus();
+  bus::device::RAM& getRam();
   Stack<StackType>& getStack();
   SymbolTable& getSymbols();
+  DynamicLinker* getDynamicLinker();
+  void setDynamicLinker(std::unique_ptr<DynamicLinker> linker);
+  Heap& getHeap();
+  bus::device::DMA& getDma();
 
  private:
   uint8_t current() const;
@@ -91,6 +114,7 @@ class VM {
   CallStackType popCall();
 
   bool executeInstruction(const abi::AddressingMode mode[2], const abi::OpCode opcode);
+  void saveProfile();
 };
 
 } /* namespace xvm */
@@ -0,0 +1,260 @@
+#include <xvm/archive.h>
+#include <xvm/version.h>
+#include <xvm/log.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define XVM_ARCHIVE_MEMBER_ALIGN 16
+
+bool xvm::Archive::addMember(const std::string& name, const Executable& object) {
+  if (!object.hasSection("symbols")) {
+    error("Can't add '%s' to archive: no 'symbols' section", name.c_str());
+    return false;
+  }
+
+  u32 member = members.size();
+  members.push_back({name, object});
+
+  auto table = SymbolTable::fromSection(object.getSection("symbols"));
+  for (const auto& symbol : table.symbols) {
+    if (symbol.isExtern() || symbol.isLocal()) {
+      continue;
+    }
+    if (!index.emplace(symbol.label, member).second) {
+      warning("Symbol '%s' of '%s' is already defined in '%s', ignoring it",
+        symbol.label.c_str(), name.c_str(), members[index[symbol.label]].name.c_str());
+    }
+  }
+
+  return true;
+}
+
+const xvm::Archive::Member* xvm::Archive::findMember(const std::string& label) const {
+  auto itr = index.find(label);
+  return itr != index.end() ? &members[itr->second] : nullptr;
+}
+
+std::vector<u8> xvm::Archive::toBytes() const {
+  std::vector<u8> buffer;
+  abi::N32 n;
+
+  auto push_u32 = [&n, &buffer] {
+    for (int i = 0; i < 4; i++)
+      buffer.push_back(n._u8[i]);
+  };
+
+  auto push_str = [&buffer](const std::string& str) {
+    buffer.insert(buffer.end(), str.begin(), str.end());
+    buffer.push_back(0);
+  };
+
+  std::vector<std::vector<u8>> objects;
+  for (const auto& member : members) {
+    objects.push_back(member.object.toBytes());
+  }
+
+  // Index is sorted, so archives built from the same objects are identical
+  std::vector<std::pair<std::string, u32>> symbols(index.begin(), index.end());
+  std::sort(symbols.begin(), symbols.end());
+
+  size_t headerSize = 16;
+  for (const auto& member : members) {
+    headerSize += 8 + member.name.size() + 1;
+  }
+  for (const auto& symbol : symbols) {
+    headerSize += 4 + symbol.first.size() + 1;
+  }
+
+  std::vector<u32> offsets;
+  size_t offset = headerSize;
+  for (const auto& object : objects) {
+    offset = (offset + XVM_ARCHIVE_MEMBER_ALIGN - 1) / XVM_ARCHIVE_MEMBER_ALIGN * XVM_ARCHIVE_MEMBER_ALIGN;
+    offsets.push_back(offset);
+    offset += object.size();
+  }
+
+  n._u32 = XVM_ARCHIVE_MAGIC;
+  push_u32();
+
+  n._u32 = XVM_VERSION_CODE;
+  push_u32();
+
+  n._u32 = members.size();
+  push_u32();
+
+  n._u32 = symbols.size();
+  push_u32();
+
+  for (size_t i = 0; i < members.size(); i++) {
+    n._u32 = offsets[i];
+    push_u32();
+
+    n._u32 = objects[i].size();
+    push_u32();
+
+    push_str(members[i].name);
+  }
+
+  for (const auto& symbol : symbols) {
+    n._u32 = symbol.second;
+    push_u32();
+
+    push_str(symbol.first);
+  }
+
+  for (size_t i = 0; i < objects.size(); i++) {
+    buffer.resize(offsets[i], 0);
+    buffer.insert(buffer.end(), objects[i].begin(), objects[i].end());
+  }
+
+  return buffer;
+}
+
+void xvm::Archive::toFile(const std::string& filename) const {
+  FILE* file = fopen(filename.c_str(), "wb");
+
+  if (!file) {
+    error("Failed to open/create '%s'", filename.c_str());
+    return;
+  }
+
+  auto buffer = toBytes();
+  fwrite(buffer.data(), 1, buffer.size(), file);
+
+  fclose(file);
+}
+
+bool xvm::Archive::isArchive(const std::string& filename) {
+  FILE* file = fopen(filename.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+
+  abi::N32 n;
+  bool isArchive = fread(n._u8, 1, 4, file) == 4 && n._u32 == XVM_ARCHIVE_MAGIC;
+
+  fclose(file);
+  return isArchive;
+}
+
+xvm::Archive xvm::Archive::fromBuffer(const u8* data, size_t size) {
+  Archive archive;
+
+  if (size < 16) {
+    return archive;
+  }
+
+  abi::N32 n;
+  abi::readInt32(n, data, 0);
+  if (n._u32 != XVM_ARCHIVE_MAGIC) {
+    return archive;
+  }
+
+  abi::readInt32(n, data, 4);
+  archive.version = n._u32;
+
+  abi::readInt32(n, data, 8);
+  u32 memberCount = n._u32;
+
+  abi::readInt32(n, data, 12);
+  u32 symbolCount = n._u32;
+
+  size_t offset = 16;
+
+  auto read_str = [data, size, &offset](std::string& str) {
+    for (; offset < size && data[offset] != '\0'; offset++) {
+      str.push_back(data[offset]);
+    }
+    offset++;
+  };
+
+  for (u32 i = 0; i < memberCount; i++) {
+    if (offset + 8 > size) {
+      error("Corrupted archive");
+      return archive;
+    }
+
+    abi::readInt32(n, data, offset);
+    u32 dataOffset = n._u32;
+
+    abi::readInt32(n, data, offset + 4);
+    u32 dataSize = n._u32;
+
+    offset += 8;
+
+    Member member;
+    read_str(member.name);
+
+    if ((size_t) dataOffset + dataSize > size) {
+      error("Corrupted archive member '%s'", member.name.c_str());
+      return archive;
+    }
+
+    member.object = Executable::fromBuffer(data + dataOffset, dataSize);
+    archive.members.push_back(std::move(member));
+  }
+
+  for (u32 i = 0; i < symbolCount; i++) {
+    if (offset + 4 > size) {
+      error("Corrupted archive");
+      return archive;
+    }
+
+    abi::readInt32(n, data, offset);
+    u32 member = n._u32;
+
+    offset += 4;
+
+    std::string label;
+    read_str(label);
+
+    if (member < archive.members.size()) {
+      archive.index.emplace(label, member);
+    }
+  }
+
+  archive.magic = XVM_ARCHIVE_MAGIC;
+  return archive;
+}
+
+xvm::Archive xvm::Archive::fromFile(const std::string& filename) {
+  Archive archive;
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1) {
+    error("Failed to open '%s'", filename.c_str());
+    return archive;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 16) {
+    error("Error: couldn't read file (errno=%d)", errno);
+    close(fd);
+    return archive;
+  }
+
+  size_t size = st.st_size;
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    error("Error: couldn't map file (errno=%d)", errno);
+    return archive;
+  }
+
+  archive = Archive::fromBuffer(static_cast<const u8*>(data), size);
+  archive.backing = std::shared_ptr<const u8>(static_cast<const u8*>(data), [size](const u8* ptr) {
+    munmap(const_cast<u8*>(ptr), size);
+  });
+
+  for (auto& member : archive.members) {
+    member.object.backing = archive.backing;
+  }
+
+  return archive;
+}
@@ -31,9 +31,12 @@
         } else if (m_tokens[m_index+1].str == "undef") {                            \
           undef();                                                                  \
         } else {                                                                    \
-          asmError("Unexistent/unsupported directive: '%s'",                        \
-            m_tokens[m_index+1].str.c_str());                                       \
-          return;                                                                   \
+          /* Other directives are left for parse() (or erased with the block) */    \
+          if (erase) {                                                              \
+            m_tokens.erase(m_tokens.begin() + m_index--);                           \
+          }                                                                         \
+          m_index++;                                                                \
+          continue;                                                                 \
         }                                                                           \
         m_tokens.erase(m_tokens.begin() + m_index, m_tokens.begin() + m_index + 2); \
         m_index--;                                                                  \
@@ -46,30 +49,48 @@
   } while (0)
 
 
-static std::string g_eof = "EOF";
+static constexpr std::string_view g_eof = "EOF";
+
+static u32 alignUp(u32 value, u32 alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
 
 
 xvm::Token::Token() {}
 
-xvm::Token::Token(TokenType type, std::string str, int line) : type(type), str(str), line(line) {}
+xvm::Token::Token(TokenType type, std::string_view str, int line) : type(type), str(str), line(line) {}
 
-xvm::Token::Token(TokenType type, const char* str, size_t length, int line) : type(type), line(line) {
-  this->str = std::string(str, length);
-}
+xvm::Token::Token(TokenType type, const char* str, size_t length, int line) : type(type), str(str, length), line(line) {}
 
 bool xvm::Token::operator==(const Token& t) const {
   return str == t.str;
 }
 
-bool xvm::Token::operator==(const std::string& s) const {
+bool xvm::Token::operator==(std::string_view s) const {
   return str == s;
 }
 
-int32_t xvm::Token::toNumber() {
+// Throws like std::stoi did, without making a string out of the token
+int32_t xvm::Token::toNumber(bool negate) const {
   int base = 10;
   if (str.size() > 2 && str[1] == 'b') base = 2;
   if (str.size() > 2 && str[1] == 'x') base = 16;
-  return std::stoi(base != 10 ? str.substr(2) : str, nullptr, base);
+  std::string_view digits = base != 10 ? str.substr(2) : str;
+
+  int64_t value = 0;
+  auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), value, base);
+  if (ec == std::errc::invalid_argument || end == digits.data()) {
+    throw std::invalid_argument("toNumber");
+  }
+  value = negate ? -value : value;
+  if (ec == std::errc::result_out_of_range || value < INT32_MIN || value > INT32_MAX) {
+    throw std::out_of_range("toNumber");
+  }
+  return value;
+}
+
+std::string_view xvm::SourceArena::add(std::string text) {
+  return m_buffers.emplace_back(std::move(text));
 }
 
 int xvm::Variable::size() const {
@@ -82,7 +103,15 @@ int xvm::Variable::size() const {
   }
 }
 
-xvm::Variable::Type xvm::Variable::stringToType(const std::string& type) {
+int xvm::Variable::elementSize() const {
+  switch (type) {
+    case Type::I16: return 2;
+    case Type::I32: return 4;
+    default:        return 1;
+  }
+}
+
+xvm::Variable::Type xvm::Variable::stringToType(std::string_view type) {
   if (type == "i8") {
     return Type::I8;
   } else if (type == "i16") {
@@ -105,8 +134,9 @@ std::string xvm::Variable::typeToString(Type type) {
   }
 }
 
-xvm::Assembler::Assembler(const std::string& filename, const std::string& source) : m_filename(filename), m_source(source) {
-  m_start = m_source.c_str();
+xvm::Assembler::Assembler(const std::string& filename, const std::string& source) : m_filename(filename) {
+  m_source = m_arena.add(source);
+  m_start = m_source.data();
   m_current = m_start;
 }
 
@@ -117,6 +147,8 @@ int xvm::Assembler::assemble(Executable& exe, bool includeSymbols) {
   parse();
   if (m_hadError) return -1;
 
+  layoutSections();
+
   patchLabels();
   if (m_hadError) return -1;
 
@@ -133,13 +165,36 @@ int xvm::Assembler::assemble(Executable& exe, bool includeSymbols) {
     0
   ));
 
+  u32 dataBase = alignUp(m_code.size(), XVM_SECTION_MEMORY_ALIGN);
+  u32 bssBase = alignUp(dataBase + m_data.size(), XVM_SECTION_MEMORY_ALIGN);
+
+  if (!m_data.empty()) {
+    exe.sections.push_back(Executable::Section(
+      SectionType::DATA,
+      "data",
+      m_data,
+      dataBase
+    ));
+  }
+
+  if (m_bssSize > 0) {
+    exe.sections.push_back(Executable::Section(
+      SectionType::BSS,
+      "bss",
+      {},
+      bssBase
+    ));
+    exe.sections.back().rawSize = m_bssSize;
+  }
+
   SymbolTable table;
   RelocationTable relocations;
 
+  // Every label and every mention is recorded, so the linker can move
+  // sections of this object apart and repatch them
   for (auto& label : m_labels) {
-    if (!m_exportAll && std::find(m_exported.begin(), m_exported.end(), label.first) == m_exported.end()) {
-      continue;
-    }
+    bool isExported = m_exportAll || std::find(m_exported.begin(), m_exported.end(), label.first) != m_exported.end();
+    bool isExtern = std::find(m_externs.begin(), m_externs.end(), label.first) != m_externs.end();
 
     int size = 0;
     u16 flags = 0;
@@ -149,11 +204,21 @@ int xvm::Assembler::assemble(Executable& exe, bool includeSymbols) {
       size = m_variables[label.first].size();
     }
 
-    if (std::find(m_externs.begin(), m_externs.end(), label.first) != m_externs.end()) {
+    if (isExtern && label.second.address == -1) {
       flags |= (u16) SymbolFlags::EXTERN;
+    } else if (!isExported) {
+      flags |= (u16) SymbolFlags::LOCAL;
+    }
 
+    if (label.second.section == SectionType::BSS) {
+      flags |= (u16) SymbolFlags::BSS;
+    } else if (label.second.section == SectionType::DATA) {
+      flags |= (u16) SymbolFlags::DATA;
+    }
+
+    if (!label.second.mentions.empty()) {
       relocations.relocations.push_back({
-        label.first, {}
+        std::string(label.first), {}
       });
 
       for (auto& mention : label.second.mentions) {
@@ -163,7 +228,7 @@ int xvm::Assembler::assemble(Executable& exe, bool includeSymbols) {
 
     table.addSymbol(
       label.second.address,
-      label.first,
+      std::string(label.first),
       flags | (u16)(label.second.isProcedure ? SymbolFlags::PROCEDURE : SymbolFlags::LABEL),
       size
     );
@@ -202,29 +267,46 @@ void xvm::Assembler::includeFile(const std::string& filename) {
     return;
   }
   m_included.push_back(filename);
-  std::ifstream sourceFile(filename);
-  std::string source((std::istreambuf_iterator<char>(sourceFile)), std::istreambuf_iterator<char>());
-  Assembler assembler(filename, source);
-  assembler.tokenize();
-  m_tokens.insert(m_tokens.begin()+m_index+1, assembler.m_tokens.begin(), assembler.m_tokens.end()-1);
+
+  std::ifstream sourceFile(filename, std::ios::binary | std::ios::ate);
+  std::string source(std::max<std::streamoff>(sourceFile.tellg(), 0), '\0');
+  sourceFile.seekg(0);
+  sourceFile.read(source.data(), source.size());
+
+  // Tokenized by this assembler into the arena, errors name the included file
+  std::string filenameBefore = std::move(m_filename);
+  int lineBefore = m_line;
+  m_filename = filename;
+
+  std::vector<Token> tokens;
+  tokenize(m_arena.add(std::move(source)), tokens);
+
+  m_filename = std::move(filenameBefore);
+  m_line = lineBefore;
+
+  m_tokens.insert(m_tokens.begin()+m_index+1, tokens.begin(), tokens.end()-1);
 }
 
 void xvm::Assembler::define(const std::string& key, const std::vector<Token>& value) {
-  m_defines[key] = value;
+  auto& tokens = m_defines[m_arena.add(key)];
+  tokens = value;
+  for (auto& token : tokens) {
+    token.str = m_arena.add(std::string(token.str));
+  }
 }
 
-void xvm::Assembler::undef(const std::string& key) {
+void xvm::Assembler::undef(std::string_view key) {
   auto itr = m_defines.find(key);
   if (itr != m_defines.end()) {
     m_defines.erase(itr);
   }
 }
 
-bool xvm::Assembler::isDefined(const std::string& key) {
+bool xvm::Assembler::isDefined(std::string_view key) {
   return m_defines.find(key) != m_defines.end();
 }
 
-std::vector<xvm::Token>& xvm::Assembler::getDefined(const std::string& key) {
+std::vector<xvm::Token>& xvm::Assembler::getDefined(std::string_view key) {
   return m_defines[key];
 }
 
@@ -236,7 +318,7 @@ void xvm::Assembler::define() {
   Token name = getNextToken();
   std::vector<Token> value;
   while (isNextTokenOnSameLine()) value.push_back(getNextToken());
-  define(name.str, value);
+  m_defines[name.str] = value;
 }
 
 void xvm::Assembler::undef() {
@@ -339,19 +421,19 @@ xvm::Token xvm::Assembler::character() {
   if (*(++m_current) != '\'') {
     asmError("Expected ' at the end of char");
   }
-  return Token(TokenType::NUMBER, std::to_string((int)c), m_line);
+  return Token(TokenType::NUMBER, m_arena.add(std::to_string((int)c)), m_line);
 }
 
 xvm::Token xvm::Assembler::number() {
   m_start = m_current;
   skipWhitespace();
   while (isdigit(*m_current) || *m_current == 'x' || (*m_current >= 'a' && *m_current <= 'f')) m_current++;
-  std::string str(m_start, m_current - m_start);
-  if (str.find('x') != std::string::npos || str.find('b') != std::string::npos) {
+  std::string_view str(m_start, m_current - m_start);
+  if (str.find('x') != std::string_view::npos || str.find('b') != std::string_view::npos) {
     if (str[0] != '0') {
       asmError("Invalid number");
     } else {
-      if (str.size() > 3 && (str.substr(3).find('x') != std::string::npos || str.substr(3).find('b') != std::string::npos)) {
+      if (str.size() > 3 && (str.substr(3).find('x') != std::string_view::npos || str.substr(3).find('b') != std::string_view::npos)) {
         asmError("Invalid number");
       }
     }
@@ -364,7 +446,12 @@ xvm::Token xvm::Assembler::string() {
   if (*m_current == '"') m_current++;
   m_start = m_current;
   while (!isAtEnd() && *m_current != '"') m_current++;
-  std::string str(m_start, m_current-m_start), result;
+  std::string_view str(m_start, m_current-m_start);
+  // Strings without escapes stay views into the source
+  if (str.find('\\') == std::string_view::npos) {
+    return Token(TokenType::STRING, str, m_line);
+  }
+  std::string result;
   for (size_t i = 0; i < str.size(); i++) {
     if (str[i] == '\\') {
       switch (str[++i]) {
@@ -389,7 +476,7 @@ xvm::Token xvm::Assembler::string() {
       result.push_back(str[i]);
     }
   }
-  return Token(TokenType::STRING, result, m_line);
+  return Token(TokenType::STRING, m_arena.add(std::move(result)), m_line);
 }
 
 xvm::Token xvm::Assembler::getNextToken() {
@@ -408,7 +495,15 @@ xvm::Token xvm::Assembler::getNextToken() {
 }
 
 void xvm::Assembler::tokenize() {
+  tokenize(m_source, m_tokens);
+}
+
+void xvm::Assembler::tokenize(std::string_view source, std::vector<Token>& tokens) {
+  // Sources in the arena are null terminated, isAtEnd relies on that
+  m_start = source.data();
   m_current = m_start;
+  m_line = 1;
+  tokens.reserve(tokens.size() + source.size() / 4);
   while (!isAtEnd() && !m_hadError) {
     m_start = m_current;
     switch (*m_current) {
@@ -424,17 +519,17 @@ void xvm::Assembler::tokenize() {
         break;
       }
       case '"': {
-        m_tokens.push_back(string());
+        tokens.push_back(string());
         m_current++;
         break;
       }
       case '%': {
-        m_tokens.push_back(Token(TokenType::PERCENT, m_start, 1, m_line));
+        tokens.push_back(Token(TokenType::PERCENT, m_start, 1, m_line));
         m_current++;
         break;
       }
       case ':': {
-        m_tokens.push_back(Token(TokenType::COLON, m_start, 1, m_line));
+        tokens.push_back(Token(TokenType::COLON, m_start, 1, m_line));
         m_current++;
         break;
       }
@@ -444,45 +539,45 @@ void xvm::Assembler::tokenize() {
         break;
       }
       case '.': {
-        m_tokens.push_back(Token(TokenType::DOT, m_start, 1, m_line));
+        tokens.push_back(Token(TokenType::DOT, m_start, 1, m_line));
         m_current++;
         break;
       }
       case '@': {
-        m_tokens.push_back(Token(TokenType::AT, m_start, 1, m_line));
+        tokens.push_back(Token(TokenType::AT, m_start, 1, m_line));
         m_current++;
         break;
       }
       case '$': {
-        m_tokens.push_back(Token(TokenType::DOLLAR, m_start, 1, m_line));
+        tokens.push_back(Token(TokenType::DOLLAR, m_start, 1, m_line));
         m_current++;
         break;
       }
       case '+': {
-        m_tokens.push_back(Token(TokenType::PLUS, m_start, 1, m_line));
+        tokens.push_back(Token(TokenType::PLUS, m_start, 1, m_line));
         m_current++;
         break;
       }
       case '-': {
-        m_tokens.push_back(Token(TokenType::MINUS, m_start, 1, m_line));
+        tokens.push_back(Token(TokenType::MINUS, m_start, 1, m_line));
         m_current++;
         break;
       }
       case '*': {
-        m_tokens.push_back(Token(TokenType::STAR, m_start, 1, m_line));
+        tokens.push_back(Token(TokenType::STAR, m_start, 1, m_line));
         m_current++;
         break;
       }
       case '\'': {
-        m_tokens.push_back(character());
+        tokens.push_back(character());
         m_current++;
         break;
       }
       default: {
         if (isalpha(*m_current)) {
-          m_tokens.push_back(identifier());
+          tokens.push_back(identifier());
         } else if (isdigit(*m_current)) {
-          m_tokens.push_back(number());
+          tokens.push_back(number());
         } else {
           asmError("Unexpected character: '%c'", *m_current);
           return;
@@ -491,14 +586,53 @@ void xvm::Assembler::tokenize() {
       }
     }
   }
-  m_tokens.push_back(Token(TokenType::IDENTIFIER, g_eof, m_tokens.back().line+1));
+  tokens.push_back(Token(TokenType::IDENTIFIER, g_eof, (tokens.empty() ? m_line : tokens.back().line) + 1));
+}
+
+bool xvm::Assembler::tryTailCall() {
+  using namespace abi;
+
+  // 'call X; ret' -> 'tailcall X', unless 'ret' is a jump target itself
+  if (m_lastOpcode == -1 || m_lastLabel == m_code.size() || m_code[m_lastOpcode+1] != CALL) {
+    return false;
+  }
+
+  AddressingMode mode = extractModeArg1(m_code[m_lastOpcode]);
+  if (m_lastOpcode + (mode == STK ? 2 : 6) != m_code.size()) {
+    return false;
+  }
+
+  m_code[m_lastOpcode+1] = TAILCALL;
+  m_lastOpcode = -1;
+  return true;
 }
 
 void xvm::Assembler::pushOpcode(abi::OpCode opcode, abi::AddressingMode mode1, abi::AddressingMode mode2) {
+  m_lastOpcode = m_code.size();
   pushByte(abi::encodeFlags(mode1, mode2));
   pushByte(opcode);
 }
 
+void xvm::Assembler::pushData(Variable::Type type, int32_t value) {
+  abi::N32 number;
+  number._i32 = value;
+  switch (type) {
+    case Variable::Type::I32:
+      m_data.push_back(number._u8[0]);
+      m_data.push_back(number._u8[1]);
+      m_data.push_back(number._u8[2]);
+      m_data.push_back(number._u8[3]);
+      break;
+    case Variable::Type::I16:
+      m_data.push_back(number._u8[0]);
+      m_data.push_back(number._u8[1]);
+      break;
+    default:
+      m_data.push_back(number._u8[0]);
+      break;
+  }
+}
+
 void xvm::Assembler::pushByte(uint8_t value) {
   m_code.push_back(value);
 }
@@ -526,19 +660,19 @@ int32_t xvm::Assembler::getAddress(u8 argumentNumber) {
   } else if (token.type == TokenType::MINUS) {
     if (isNextTokenOnSameLine()) {
       m_tokens.erase(m_tokens.begin() + m_index);
-      m_tokens[m_index].str.insert(m_tokens[m_index].str.begin(), '-');
-      return m_tokens[m_index].toNumber();
+      return m_tokens[m_index].toNumber(true);
     }
   } else if (token.type == TokenType::IDENTIFIER) {
     m_labels[token.str].mentions.push_back({static_cast<int32_t>(m_code.size()), argumentNumber});
     int32_t addressOffset = 0;
     Token nextToken = m_tokens[m_index+1];
+    // Only a number can be added, a second label would need a relocation of its own
     if (nextToken.type == TokenType::PLUS) {
       m_index++;
-      addressOffset += getAddress(0);
+      addressOffset += getCount();
     } else if (nextToken.type == TokenType::MINUS) {
       m_index++;
-      addressOffset -= getAddress(0);
+      addressOffset -= getCount();
     }
     return addressOffset;
   } else {
@@ -547,28 +681,64 @@ int32_t xvm::Assembler::getAddress(u8 argumentNumber) {
   return 0;
 }
 
+int32_t xvm::Assembler::getFrameSlot() {
+  Token token = getNextToken();
+  if (token.type == TokenType::NUMBER) {
+    return token.toNumber();
+  } else if (token.type == TokenType::IDENTIFIER) {
+    if (m_frameSlots.find(token.str) != m_frameSlots.end()) {
+      return m_frameSlots[token.str];
+    }
+    asmError(token, "Unknown frame slot '%.*s'", static_cast<int>(token.str.size()), token.str.data());
+  } else {
+    asmError(token, "Expected frame slot number or name");
+  }
+  return 0;
+}
+
+// Plain number, unlike getAddress it never records a label mention
+int32_t xvm::Assembler::getCount() {
+  Token token = getNextToken();
+  if (token.type == TokenType::NUMBER) {
+    return token.toNumber();
+  }
+  asmError(token, "Expected number");
+  return 0;
+}
+
+void xvm::Assembler::layoutSections() {
+  // [code][data][bss], labels in data and bss are offsets until here
+  u32 dataBase = alignUp(m_code.size(), XVM_SECTION_MEMORY_ALIGN);
+  u32 bssBase = alignUp(dataBase + m_data.size(), XVM_SECTION_MEMORY_ALIGN);
+
+  for (auto& label : m_labels) {
+    if (label.second.address == -1 || label.second.section == SectionType::CODE) {
+      continue;
+    }
+    label.second.address += label.second.section == SectionType::DATA ? dataBase : bssBase;
+    m_variables[label.first].address = label.second.address;
+  }
+}
+
 void xvm::Assembler::patchLabels() { // TODO: check for unpatched labels
   using namespace abi;
 
   for (auto& label : m_labels) {
-    debug(2, "Label: '%s' at 0x%x", label.first.c_str(), label.second.address);
+    debug(2, "Label: '%.*s' at 0x%x", static_cast<int>(label.first.size()), label.first.data(), label.second.address);
+    bool isExtern = std::find(m_externs.begin(), m_externs.end(), label.first) != m_externs.end();
     for (auto mention : label.second.mentions) {
-      if (label.second.address == -1 && std::find(m_externs.begin(), m_externs.end(), label.first) == m_externs.end()) {
-        error("Unknown label: %s", label.first.c_str());
-        m_hadError = true;
-      }
-      N32 value;
-      if (config::asBool("pic")) {
-        patchAddressingMode(label.second.address, mention.address, mention.argumentNumber);
-        value._i32 = std::abs(label.second.address - mention.address);
-      } else {
-        value._i32 = label.second.address;
+      if (label.second.address == -1) {
+        if (!isExtern) {
+          error("Unknown label: %.*s", static_cast<int>(label.first.size()), label.first.data());
+          m_hadError = true;
+        }
+        // Argument keeps the addend, linker resolves the rest
+        continue;
       }
-      m_code[mention.address]   += value._u8[0];
-      m_code[mention.address+1] += value._u8[1];
-      m_code[mention.address+2] += value._u8[2];
-      m_code[mention.address+3] += value._u8[3];
-      debug(2, "Label '%s' mention at 0x%x patched", label.first.c_str(), mention.address);
+      N32 addend;
+      readInt32(addend, m_code.data(), mention.address);
+      encodeAddress(m_code.data(), label.second.address + addend._i32, mention.address, mention.argumentNumber, config::asBool("pic"));
+      debug(2, "Label '%.*s' mention at 0x%x patched", static_cast<int>(label.first.size()), label.first.data(), mention.address);
     }
   }
 }
@@ -577,10 +747,10 @@ void xvm::Assembler::patchVariables() {
   using namespace abi;
 
   for (auto& var : m_variables) {
-    debug(2, "Variable: '%s' type '%s' at 0x%x", var.first.c_str(), Variable::typeToString(var.second.type).c_str(), var.second.address);
+    debug(2, "Variable: '%.*s' type '%s' at 0x%x", static_cast<int>(var.first.size()), var.first.data(), Variable::typeToString(var.second.type).c_str(), var.second.address);
     for (auto mention : var.second.mentions) {
       if (var.second.address == -1) {
-        error("Unknown variable: %s", var.first.c_str());
+        error("Unknown variable: %.*s", static_cast<int>(var.first.size()), var.first.data());
         m_hadError = true;
       }
       N32 value;
@@ -607,47 +777,16 @@ void xvm::Assembler::patchVariables() {
         }
         m_code[mention.address]   = encodeFlags(STK, _NONE); //encodeInstruction(STK, _NONE, op);
         m_code[mention.address+1] = op; 
-        debug(2, "Variable '%s' deref mention at 0x%x patched with %s", var.first.c_str(), mention.address, opCodeToString(op).c_str());
+        debug(2, "Variable '%.*s' deref mention at 0x%x patched with %s", static_cast<int>(var.first.size()), var.first.data(), mention.address, opCodeToString(op).c_str());
       } else {
-        if (config::asBool("pic")) {
-          patchAddressingMode(var.second.address, mention.address, mention.argumentNumber);
-          value._i32 = std::abs(var.second.address - mention.address);
-        } else {
-          value._i32 = var.second.address;
-        }
-        m_code[mention.address]   += value._u8[0];
-        m_code[mention.address+1] += value._u8[1];
-        m_code[mention.address+2] += value._u8[2];
-        m_code[mention.address+3] += value._u8[3];
-        debug(2, "Variable '%s' mention at 0x%x patched", var.first.c_str());
+        readInt32(value, m_code.data(), mention.address);
+        encodeAddress(m_code.data(), var.second.address + value._i32, mention.address, mention.argumentNumber, config::asBool("pic"));
+        debug(2, "Variable '%.*s' mention at 0x%x patched", static_cast<int>(var.first.size()), var.first.data(), mention.address);
       }
     }
   }
 }
 
-void xvm::Assembler::patchAddressingMode(i32 labelAddress, i32 mentionAddress, u8 argumentNumber) {
-  using namespace abi;
-  if (labelAddress - mentionAddress < 0) {
-    // NRO
-    if (argumentNumber == 1) {
-      auto mode2 = extractModeArg2(m_code[mentionAddress - 2]);
-      m_code[mentionAddress - 2] = encodeFlags(NRO, mode2);
-    } else if (argumentNumber == 2) {
-      auto mode1 = extractModeArg1(m_code[mentionAddress - 6]);
-      m_code[mentionAddress - 6] = encodeFlags(mode1, NRO);
-    }
-  } else {
-    // PRO
-    if (argumentNumber == 1) {
-      auto mode2 = extractModeArg2(m_code[mentionAddress - 2]);
-      m_code[mentionAddress - 2] = encodeFlags(PRO, mode2);
-    } else if (argumentNumber == 2) {
-      auto mode1 = extractModeArg1(m_code[mentionAddress - 6]);
-      m_code[mentionAddress - 6] = encodeFlags(mode1, PRO);
-    }
-  }
-}
-
 void xvm::Assembler::parse() {
   using namespace abi;
 
@@ -972,7 +1111,7 @@ void xvm::Assembler::parse() {
             if (m_syscalls.find(token.str) != m_syscalls.end()) {
               pushInt32(m_syscalls[token.str]);
             } else {
-              asmError("No syscall definition for '%.*s' found", token.str.size(), token.str.data());
+              asmError("No syscall definition for '%.*s' found", static_cast<int>(token.str.size()), token.str.data());
             }
           } else {
             asmError("Expecter number or identifier for syscall");
@@ -982,13 +1121,67 @@ void xvm::Assembler::parse() {
           pushOpcode(SYSCALL, STK);
         }
       } else if (m_tokens[m_index] == "ret") {
-        pushOpcode(RET, _NONE);
+        if (!config::asBool("tail-calls") || !tryTailCall()) {
+          pushOpcode(RET, _NONE);
+        }
+      } else if (m_tokens[m_index] == "enter") {
+        // enter [ARGS [LOCALS]] or enter [ARG_NAME..] [: LOCAL_NAME..]
+        m_frameSlots.clear();
+        int32_t args = 0, locals = 0;
+        bool isLocal = false;
+        while (isNextTokenOnSameLine()) {
+          Token token = getNextToken();
+          if (token.type == TokenType::COLON) {
+            isLocal = true;
+          } else if (token.type == TokenType::NUMBER) {
+            (isLocal ? locals : args) = token.toNumber();
+            isLocal = true;
+          } else if (token.type == TokenType::IDENTIFIER) {
+            m_frameSlots[token.str] = args + locals;
+            (isLocal ? locals : args)++;
+          } else {
+            asmError(token, "Expected frame slot count or name");
+            return;
+          }
+        }
+        pushOpcode(ENTER, IMM, IMM);
+        pushInt32(args);
+        pushInt32(locals);
+      } else if (m_tokens[m_index] == "leave") {
+        if (isNextTokenOnSameLine()) {
+          pushOpcode(LEAVE, IMM);
+          pushInt32(getCount());
+        } else {
+          pushOpcode(LEAVE, _NONE);
+        }
+      } else if (m_tokens[m_index] == "loadl") {
+        if (!isNextTokenOnSameLine()) {
+          asmError("Expected frame slot");
+          return;
+        }
+        pushOpcode(LOADL, IMM);
+        pushInt32(getFrameSlot());
+      } else if (m_tokens[m_index] == "storel") {
+        if (!isNextTokenOnSameLine()) {
+          asmError("Expected frame slot");
+          return;
+        }
+        pushOpcode(STOREL, IMM);
+        pushInt32(getFrameSlot());
+      } else if (m_tokens[m_index] == "pick") {
+        if (!isNextTokenOnSameLine()) {
+          asmError("Expected stack distance");
+          return;
+        }
+        pushOpcode(PICK, IMM);
+        pushInt32(getCount());
       } else {
         if (m_tokens[m_index+1].type == TokenType::COLON) {
           m_labels[m_tokens[m_index].str].address = m_code.size();
+          m_lastLabel = m_code.size();
           m_index++;
         } else {
-          asmError(m_tokens[m_index], "Unexpected identifier: '%.*s'", m_tokens[m_index].str.size(), m_tokens[m_index].str.data());
+          asmError(m_tokens[m_index], "Unexpected identifier: '%.*s'", static_cast<int>(m_tokens[m_index].str.size()), m_tokens[m_index].str.data());
         }
       }
     } else if (m_tokens[m_index].type == TokenType::PERCENT) {
@@ -1023,28 +1216,58 @@ void xvm::Assembler::parse() {
             return;
           }
           Token value = getNextToken();
-          m_labels[name.str].address = m_code.size();
+          m_labels[name.str].address = m_data.size();
+          m_labels[name.str].section = SectionType::DATA;
           int count = 1;
-          if (type.str == "i8") {
-            pushByte(value.toNumber());
-          } else if (type.str == "i16") {
-            pushInt16(value.toNumber());
-          } else if (type.str == "i32") {
-            pushInt32(value.toNumber());
+          if (type.str == "i8" || type.str == "i16" || type.str == "i32") {
+            pushData(Variable::stringToType(type.str), value.toNumber());
           } else if (type.str == "str") {
             count = value.str.size();
             for (size_t i = 0; i < value.str.size(); i++) {
-              pushByte(value.str[i]);
+              pushData(Variable::Type::I8, value.str[i]);
             }
-            pushByte(0);
+            pushData(Variable::Type::I8, 0);
           } else {
-            asmError("Unknown type '%.*s'", type.str.size(), type.str.data());
+            asmError("Unknown type '%.*s'", static_cast<int>(type.str.size()), type.str.data());
             return;
           }
           m_variables[name.str].name = name.str;
           m_variables[name.str].address = m_labels[name.str].address;
           m_variables[name.str].type = Variable::stringToType(type.str);
           m_variables[name.str].count = count;
+        } else if (m_tokens[m_index] == "reserve") {
+          // %reserve TYPE NAME COUNT - zero-initialized, takes no space in executable
+          if (!isNextTokenOnSameLine()) {
+            asmError("Expected variable type");
+            return;
+          }
+          Token type = getNextToken();
+          if (!isNextTokenOnSameLine()) {
+            asmError("Expected variable name");
+            return;
+          }
+          Token name = getNextToken();
+          int count = 1;
+          if (isNextTokenOnSameLine()) {
+            count = getCount();
+          }
+          if (type.str != "i8" && type.str != "i16" && type.str != "i32") {
+            asmError("Unknown type '%.*s'", static_cast<int>(type.str.size()), type.str.data());
+            return;
+          }
+          if (count <= 0) {
+            asmError(name, "Reserve count has to be positive");
+            return;
+          }
+          auto& variable = m_variables[name.str];
+          variable.name = name.str;
+          variable.type = Variable::stringToType(type.str);
+          variable.count = count;
+          // Keeps variables of bigger types aligned
+          m_bssSize = alignUp(m_bssSize, variable.elementSize());
+          m_labels[name.str].address = m_bssSize;
+          m_labels[name.str].section = SectionType::BSS;
+          m_bssSize += variable.size();
         } else if (m_tokens[m_index] == "syscall") {
           if (!isNextTokenOnSameLine()) {
             asmError("Expected syscall name");
@@ -1077,7 +1300,7 @@ void xvm::Assembler::parse() {
             }
           }
           if (!fileIncluded) {
-            asmError(file, "Can't include '%s': no such file found in include path", file.str.c_str());
+            asmError(file, "Can't include '%.*s': no such file found in include path", static_cast<int>(file.str.size()), file.str.data());
             return;
           }
         } else if (m_tokens[m_index] == "define") {
@@ -1114,7 +1337,7 @@ void xvm::Assembler::parse() {
             } else if (type.str == "i32") {
               pushInt32(val);
             } else {
-              error("Unknown type '%s'", type.str.c_str());
+              error("Unknown type '%.*s'", static_cast<int>(type.str.size()), type.str.data());
               return;
             }
           }
@@ -1144,7 +1367,7 @@ void xvm::Assembler::parse() {
             } else if (type.str == "i32") {
               pushInt32(val);
             } else {
-              error("Unknown type '%s'", type.str.c_str());
+              error("Unknown type '%.*s'", static_cast<int>(type.str.size()), type.str.data());
               return;
             }
           }
@@ -1159,21 +1382,16 @@ void xvm::Assembler::parse() {
             return;
           }
           Token name = getNextToken();
-          m_labels[name.str].address = m_code.size();
+          if (type.str != "i8" && type.str != "i16" && type.str != "i32") {
+            error("Unknown type '%.*s'", static_cast<int>(type.str.size()), type.str.data());
+            return;
+          }
+          m_labels[name.str].address = m_data.size();
+          m_labels[name.str].section = SectionType::DATA;
           int count = 0;
           while (isNextTokenOnSameLine()) {
             count++;
-            int val = getNextToken().toNumber();
-            if (type.str == "i8") {
-              pushByte(val);
-            } else if (type.str == "i16") {
-              pushInt16(val);
-            } else if (type.str == "i32") {
-              pushInt32(val);
-            } else {
-              error("Unknown type '%s'", type.str.c_str());
-              return;
-            }
+            pushData(Variable::stringToType(type.str), getNextToken().toNumber());
           }
           m_variables[name.str].name = name.str;
           m_variables[name.str].address = m_labels[name.str].address;
@@ -1206,7 +1424,7 @@ void xvm::Assembler::parse() {
             m_externs.push_back(externName.str);
           }
         } else {
-          asmError("Unknown directive '%s'", m_tokens[m_index].str.c_str());
+          asmError("Unknown directive '%.*s'", static_cast<int>(m_tokens[m_index].str.size()), m_tokens[m_index].str.data());
           return;
         }
 
@@ -8,19 +8,19 @@ std::string xvm::bus::Device::getName() const {
   return m_name;
 }
 
-xvm::bus::Bus::Dev::~Dev() {
-  if (destroy) {
-    delete device;
-  }
-}
-
 bool xvm::bus::Bus::Dev::check(size_t address) const {
   return address >= beginAddr && address <= endAddr;
 }
 
 xvm::bus::Bus::Bus() {}
 
-xvm::bus::Bus::~Bus() {}
+xvm::bus::Bus::~Bus() {
+  for (auto& dev : m_devices) {
+    if (dev.destroy) {
+      delete dev.device;
+    }
+  }
+}
 
 uint8_t xvm::bus::Bus::read(size_t address) const {
   for (auto& dev : m_devices) {
@@ -40,16 +40,66 @@ void xvm::bus::Bus::write(size_t address, uint8_t value) {
   }
 }
 
-void xvm::bus::Bus::bind(size_t address, size_t length, Device* dev, bool destroy) {
-  for (auto& dev : m_devices) {
-    if (dev.check(address) || dev.check(address+length)) {
-      // ERROR //
-      return;
+bool xvm::bus::Bus::bind(size_t address, size_t length, Device* dev, bool destroy) {
+  for (auto& d : m_devices) {
+    if (d.beginAddr <= address+length && d.endAddr >= address) {
+      return false;
     }
   }
   m_min = std::min(m_min, address);
   m_max = std::max(m_max, address+length);
   m_devices.push_back({address, address+length, dev, destroy});
+  return true;
+}
+
+// Unlike bind, overlapping is allowed: the device shadows whatever is
+// already mapped in [address; address+length]
+void xvm::bus::Bus::overlay(size_t address, size_t length, Device* dev, bool destroy) {
+  m_min = std::min(m_min, address);
+  m_max = std::max(m_max, address+length);
+  m_devices.insert(m_devices.begin(), {address, address+length, dev, destroy});
+}
+
+void xvm::bus::Bus::unbind(Device* dev) {
+  for (auto itr = m_devices.begin(); itr != m_devices.end(); itr++) {
+    if (itr->device == dev) {
+      if (itr->destroy) {
+        delete itr->device;
+      }
+      m_devices.erase(itr);
+      break;
+    }
+  }
+  m_max = m_min;
+  for (auto& d : m_devices) {
+    m_max = std::max(m_max, d.endAddr);
+  }
+}
+
+bool xvm::bus::Bus::resize(Device* dev, size_t length) {
+  Dev* target = nullptr;
+  for (auto& d : m_devices) {
+    if (d.device == dev) {
+      target = &d;
+    }
+  }
+  if (!target) {
+    return false;
+  }
+
+  size_t endAddr = target->beginAddr + length;
+  for (auto& d : m_devices) {
+    if (&d != target && d.beginAddr <= endAddr && d.endAddr >= target->beginAddr) {
+      return false;
+    }
+  }
+
+  target->endAddr = endAddr;
+  m_max = m_min;
+  for (auto& d : m_devices) {
+    m_max = std::max(m_max, d.endAddr);
+  }
+  return true;
 }
 
 xvm::bus::Device* xvm::bus::Bus::getDevice(size_t index) const {
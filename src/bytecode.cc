@@ -50,6 +50,12 @@ std::string xvm::abi::opCodeToString(OpCode opcode) {
     case CALL:    return "call";
     case SYSCALL: return "syscall";
     case RET:     return "ret";
+    case ENTER:   return "enter";
+    case LEAVE:   return "leave";
+    case LOADL:   return "loadl";
+    case STOREL:  return "storel";
+    case PICK:    return "pick";
+    case TAILCALL: return "tailcall";
     default:      return "<error>";
   }
 }
@@ -77,6 +83,108 @@ void xvm::abi::decodeIntstruction(const Intstruction instruction, AddressingMode
   mode2 = extractModeArg2(flags);
 }
 
+static u8* flagsOf(u8* code, i32 mention, u8 argumentNumber) {
+  return &code[mention - (argumentNumber == 2 ? 6 : 2)];
+}
+
+i32 xvm::abi::decodeAddress(const u8* code, i32 mention, u8 argumentNumber) {
+  u8 flags = *flagsOf(const_cast<u8*>(code), mention, argumentNumber);
+  AddressingMode mode = argumentNumber == 2 ? extractModeArg2(flags) : extractModeArg1(flags);
+
+  N32 value;
+  readInt32(value, code, mention);
+
+  switch (mode) {
+    case PRO: return mention + value._i32;
+    case NRO: return mention - value._i32;
+    default:  return value._i32;
+  }
+}
+
+void xvm::abi::encodeAddress(u8* code, i32 address, i32 mention, u8 argumentNumber, bool pic) {
+  u8* flags = flagsOf(code, mention, argumentNumber);
+  AddressingMode mode1 = extractModeArg1(*flags), mode2 = extractModeArg2(*flags);
+  AddressingMode& mode = argumentNumber == 2 ? mode2 : mode1;
+
+  N32 value;
+  if (pic) {
+    mode = address < mention ? NRO : PRO;
+    value._i32 = address < mention ? mention - address : address - mention;
+  } else {
+    if (mode == PRO || mode == NRO) {
+      mode = IMM;
+    }
+    value._i32 = address;
+  }
+
+  if (argumentNumber != 0) {
+    *flags = encodeFlags(mode1, mode2);
+  }
+
+  for (int i = 0; i < 4; i++) {
+    code[mention + i] = value._u8[i];
+  }
+}
+
+int xvm::abi::instructionSize(const u8* code, int offset) {
+  AddressingMode mode[] = {
+    extractModeArg1(code[offset]),
+    extractModeArg2(code[offset])
+  };
+
+  auto hasArg = [](AddressingMode mode) {
+    return mode == IMM || mode == ABS || mode == PRO || mode == NRO;
+  };
+
+  switch ((OpCode) code[offset+1]) {
+    case PUSH:
+    case JUMP:
+    case JUMPT:
+    case JUMPF:
+    case CALL:
+    case TAILCALL:
+      return 2 + (hasArg(mode[0]) ? 4 : 0);
+    case ADD:
+    case SUB:
+    case MUL:
+    case DIV:
+    case EQU:
+    case LT:
+    case GT:
+    case AND:
+    case OR:
+      return 2 + (hasArg(mode[0]) ? 4 : 0) + (hasArg(mode[1]) ? 4 : 0);
+    case DEC:
+    case INC:
+      return 2 + (mode[0] == ABS ? 4 : 0);
+    case SHL:
+    case SHR:
+      return 6 + (mode[1] == ABS ? 4 : 0);
+    case DEREF8:
+    case DEREF16:
+    case DEREF32:
+    case LOAD8:
+    case LOAD16:
+    case LOAD32:
+    case POP:
+    case SYSCALL:
+    case LEAVE:
+      return 2 + (mode[0] == IMM ? 4 : 0);
+    case STORE8:
+    case STORE16:
+    case STORE32:
+      return 2 + (mode[1] == IMM ? 4 : 0);
+    case ENTER:
+      return 10;
+    case LOADL:
+    case STOREL:
+    case PICK:
+      return 6;
+    default:
+      return 2;
+  }
+}
+
 int xvm::abi::disassembleInstruction(const uint8_t* data, int offset) {
   AddressingMode mode[] = {
     extractModeArg1(data[offset]),
@@ -159,7 +267,8 @@ int xvm::abi::disassembleInstruction(const uint8_t* data, int offset) {
     case JUMP:
     case JUMPT:
     case JUMPF:
-    case CALL: {
+    case CALL:
+    case TAILCALL: {
       for (int i = 0; i < 2; i++) {
         N32 result;
         switch (mode[i]) {
@@ -190,6 +299,26 @@ int xvm::abi::disassembleInstruction(const uint8_t* data, int offset) {
       printf("\n");
       return offset;
     }
+    case ENTER: {
+      N32 args, locals;
+      readInt32(args, data, offset+1);
+      readInt32(locals, data, offset+5);
+      printf("%d %d\n", args._i32, locals._i32);
+      return offset+9;
+    }
+    case LEAVE:
+    case LOADL:
+    case STOREL:
+    case PICK: {
+      if (mode[0] == IMM) {
+        N32 result;
+        readInt32(result, data, offset+1);
+        printf("%d\n", result._i32);
+        return offset+5;
+      }
+      printf("\n");
+      return offset+1;
+    }
     case SYSCALL: {
       if (mode[0] == IMM) {
         N32 result;
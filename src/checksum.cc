@@ -0,0 +1,90 @@
+#include <xvm/checksum.h>
+
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define XVM_CRC32C_HW 1
+#endif
+
+#define CRC32C_POLY 0x82f63b78 // Reflected Castagnoli polynomial
+
+namespace {
+
+struct Tables {
+  u32 t[8][256];
+
+  Tables() {
+    for (u32 i = 0; i < 256; i++) {
+      u32 crc = i;
+      for (int j = 0; j < 8; j++) {
+        crc = (crc >> 1) ^ (CRC32C_POLY & -(crc & 1));
+      }
+      t[0][i] = crc;
+    }
+    for (u32 i = 0; i < 256; i++) {
+      for (int k = 1; k < 8; k++) {
+        t[k][i] = (t[k-1][i] >> 8) ^ t[0][t[k-1][i] & 0xff];
+      }
+    }
+  }
+};
+
+const Tables g_tables;
+
+u32 crc32cSoftware(const u8* data, size_t length, u32 crc) {
+  const auto& t = g_tables.t;
+
+  while (length >= 8) {
+    u32 lo, hi;
+    memcpy(&lo, data, 4);
+    memcpy(&hi, data + 4, 4);
+    lo ^= crc;
+    crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+        ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    data += 8;
+    length -= 8;
+  }
+
+  while (length--) {
+    crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xff];
+  }
+
+  return crc;
+}
+
+#ifdef XVM_CRC32C_HW
+__attribute__((target("sse4.2")))
+u32 crc32cHardware(const u8* data, size_t length, u32 crc) {
+  uint64_t crc64 = crc;
+
+  while (length >= 8) {
+    uint64_t value;
+    memcpy(&value, data, 8);
+    crc64 = _mm_crc32_u64(crc64, value);
+    data += 8;
+    length -= 8;
+  }
+
+  crc = (u32) crc64;
+  while (length--) {
+    crc = _mm_crc32_u8(crc, *data++);
+  }
+
+  return crc;
+}
+
+const bool g_hasHardwareCrc = __builtin_cpu_supports("sse4.2");
+#endif
+
+} /* namespace */
+
+u32 xvm::crc32c(const u8* data, size_t length, u32 crc) {
+  crc = ~crc;
+#ifdef XVM_CRC32C_HW
+  if (g_hasHardwareCrc) {
+    return ~crc32cHardware(data, length, crc);
+  }
+#endif
+  return ~crc32cSoftware(data, length, crc);
+}
@@ -0,0 +1,139 @@
+#include <xvm/compress.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define LZ_MIN_MATCH    4
+#define LZ_MAX_OFFSET   65535
+#define LZ_HASH_BITS    14
+
+static u32 read32(const u8* data) {
+  u32 value;
+  memcpy(&value, data, 4);
+  return value;
+}
+
+static u32 hash(u32 value) {
+  return (value * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+static void pushLength(std::vector<u8>& out, size_t length) {
+  while (length >= 255) {
+    out.push_back(255);
+    length -= 255;
+  }
+  out.push_back(length);
+}
+
+static void pushSequence(std::vector<u8>& out, const u8* literals, size_t literalCount, size_t offset, size_t matchLength) {
+  size_t matchCode = matchLength ? matchLength - LZ_MIN_MATCH : 0;
+
+  out.push_back((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(matchCode, 15));
+  if (literalCount >= 15) {
+    pushLength(out, literalCount - 15);
+  }
+
+  out.insert(out.end(), literals, literals + literalCount);
+
+  if (matchLength) {
+    out.push_back(offset & 0xff);
+    out.push_back(offset >> 8);
+    if (matchCode >= 15) {
+      pushLength(out, matchCode - 15);
+    }
+  }
+}
+
+std::vector<u8> xvm::lz::compress(const u8* data, size_t length) {
+  std::vector<u8> out;
+  out.reserve(length / 2 + 16);
+
+  std::vector<i32> table(1 << LZ_HASH_BITS, -1);
+
+  size_t anchor = 0;
+  size_t i = 0;
+
+  while (i + LZ_MIN_MATCH <= length) {
+    u32 value = read32(data + i);
+    u32 h = hash(value);
+    i32 candidate = table[h];
+    table[h] = i;
+
+    if (candidate < 0 || i - candidate > LZ_MAX_OFFSET || read32(data + candidate) != value) {
+      i++;
+      continue;
+    }
+
+    size_t matchLength = LZ_MIN_MATCH;
+    while (i + matchLength < length && data[candidate + matchLength] == data[i + matchLength]) {
+      matchLength++;
+    }
+
+    pushSequence(out, data + anchor, i - anchor, i - candidate, matchLength);
+
+    i += matchLength;
+    anchor = i;
+  }
+
+  pushSequence(out, data + anchor, length - anchor, 0, 0);
+
+  return out;
+}
+
+bool xvm::lz::decompress(const u8* data, size_t length, u8* dst, size_t dstLength) {
+  const u8* end = data + length;
+  size_t out = 0;
+
+  auto readLength = [&data, end](size_t& result) {
+    u8 byte;
+    do {
+      if (data >= end) return false;
+      byte = *data++;
+      result += byte;
+    } while (byte == 255);
+    return true;
+  };
+
+  while (data < end) {
+    u8 token = *data++;
+
+    size_t literalCount = token >> 4;
+    if (literalCount == 15 && !readLength(literalCount)) {
+      return false;
+    }
+
+    if (literalCount > (size_t) (end - data) || literalCount > dstLength - out) {
+      return false;
+    }
+    memcpy(dst + out, data, literalCount);
+    data += literalCount;
+    out += literalCount;
+
+    if (data == end) {
+      break;
+    }
+
+    if (end - data < 2) {
+      return false;
+    }
+    size_t offset = data[0] | (data[1] << 8);
+    data += 2;
+
+    size_t matchLength = token & 0xf;
+    if (matchLength == 15 && !readLength(matchLength)) {
+      return false;
+    }
+    matchLength += LZ_MIN_MATCH;
+
+    if (offset == 0 || offset > out || matchLength > dstLength - out) {
+      return false;
+    }
+
+    // Byte by byte, matches may overlap the bytes they produce
+    for (size_t j = 0; j < matchLength; j++, out++) {
+      dst[out] = dst[out - offset];
+    }
+  }
+
+  return out == dstLength;
+}
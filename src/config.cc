@@ -15,7 +15,25 @@ void xvm::config::initialize() {
   set("print-symbol-table", 0);
   set("include-symbols", 1);
   set("pic", 1);
+  set("tail-calls", 1);
   set("ram-size", 2048);
+  set("ram-max-size", 1024 * 1024 * 1024);
+  set("ram-hugepages", 0);
+  set("rom", 0);
+  set("verify-checksums", 1);
+  set("compress", 1);
+  set("link-threads", 0);
+  set("link-gc", 1);
+  set("link-profile", "");
+  set("link-incremental", 0);
+  set("link-inline", 0);
+  set("link-shared", 0);
+  set("dynamic-libs", "");
+  set("dynamic-lib-path", "");
+  set("dynamic-lazy", 1);
+  set("profile", "");
+  set("stack-size", 65536);
+  set("call-stack-size", 65536);
   set("version", XVM_VERSION);
   set("version-major", XVM_VERSION_MAJOR);
   set("version-minor", XVM_VERSION_MINOR);
@@ -0,0 +1,104 @@
+#include <xvm/devices/dma.h>
+#include <xvm/log.h>
+
+xvm::bus::device::DMA::DMA(Bus* bus) : Device(XVM_BUS_DEV_DMA_NAME), m_bus(bus) {
+  m_src._u32 = 0;
+  m_dst._u32 = 0;
+  m_len._u32 = 0;
+}
+
+xvm::bus::device::DMA::~DMA() {
+  wait();
+}
+
+void xvm::bus::device::DMA::initialize(size_t base) {
+  m_baseAddr = base;
+}
+
+void xvm::bus::device::DMA::start() {
+  if (m_status & XVM_DMA_STATUS_BUSY) {
+    warning("dma: transfer already in progress");
+    return;
+  }
+
+  wait();
+
+  m_status = XVM_DMA_STATUS_BUSY;
+  m_worker = std::thread(&DMA::transfer, this, m_src._u32, m_dst._u32, m_len._u32);
+}
+
+void xvm::bus::device::DMA::wait() {
+  if (m_worker.joinable()) {
+    m_worker.join();
+  }
+}
+
+void xvm::bus::device::DMA::transfer(u32 src, u32 dst, u32 len) {
+  if (len == 0) {
+    m_status = XVM_DMA_STATUS_DONE;
+    return;
+  }
+
+  Device* srcDev = m_bus->getDeviceByAddress(src);
+  Device* dstDev = m_bus->getDeviceByAddress(dst);
+
+  if (!srcDev || !dstDev || srcDev == this || dstDev == this) {
+    m_status = XVM_DMA_STATUS_DONE | XVM_DMA_STATUS_ERROR;
+    return;
+  }
+
+  // Regions that span several devices go through the bus byte by byte
+  if (srcDev != m_bus->getDeviceByAddress(src + len - 1) || dstDev != m_bus->getDeviceByAddress(dst + len - 1)) {
+    for (u32 i = 0; i < len; i++) {
+      m_bus->write(dst + i, m_bus->read(src + i));
+    }
+  } else if (dst > src && dst < src + len && srcDev == dstDev) {
+    for (u32 i = len; i > 0; i--) {
+      dstDev->write(dst + i - 1, srcDev->read(src + i - 1));
+    }
+  } else {
+    for (u32 i = 0; i < len; i++) {
+      dstDev->write(dst + i, srcDev->read(src + i));
+    }
+  }
+
+  m_status = XVM_DMA_STATUS_DONE;
+}
+
+uint8_t xvm::bus::device::DMA::read(size_t address) {
+  size_t reg = address - m_baseAddr;
+
+  if (reg < XVM_DMA_DST_REGISTER) {
+    return m_src._u8[reg - XVM_DMA_SRC_REGISTER];
+  } else if (reg < XVM_DMA_LEN_REGISTER) {
+    return m_dst._u8[reg - XVM_DMA_DST_REGISTER];
+  } else if (reg < XVM_DMA_CONTROL_REGISTER) {
+    return m_len._u8[reg - XVM_DMA_LEN_REGISTER];
+  } else if (reg == XVM_DMA_STATUS_REGISTER) {
+    return m_status;
+  }
+  return 0;
+}
+
+void xvm::bus::device::DMA::write(size_t address, uint8_t value) {
+  size_t reg = address - m_baseAddr;
+
+  if (m_status & XVM_DMA_STATUS_BUSY && reg < XVM_DMA_CONTROL_REGISTER) {
+    warning("dma: attempted write into transfer registers while busy");
+    return;
+  }
+
+  if (reg < XVM_DMA_DST_REGISTER) {
+    m_src._u8[reg - XVM_DMA_SRC_REGISTER] = value;
+  } else if (reg < XVM_DMA_LEN_REGISTER) {
+    m_dst._u8[reg - XVM_DMA_DST_REGISTER] = value;
+  } else if (reg < XVM_DMA_CONTROL_REGISTER) {
+    m_len._u8[reg - XVM_DMA_LEN_REGISTER] = value;
+  } else if (reg == XVM_DMA_CONTROL_REGISTER) {
+    if (value == XVM_DMA_CONTROL_START) {
+      start();
+    }
+  } else if (reg == XVM_DMA_STATUS_REGISTER) {
+    warning("dma: attempted write into status register");
+  }
+}
@@ -0,0 +1,75 @@
+#include <xvm/devices/mapped_file.h>
+#include <xvm/log.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+xvm::bus::device::MappedFile::MappedFile(const std::string& filename, size_t base, bool writable)
+  : Device(XVM_BUS_DEV_MAPPED_FILE_NAME), m_baseAddr(base), m_writable(writable) {
+  int fd = open(filename.c_str(), writable ? O_RDWR : O_RDONLY);
+  if (fd == -1) {
+    debug("Failed to open '%s' for mapping (errno: %d)", filename.c_str(), errno);
+    return;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return;
+  }
+
+  void* buffer = mmap(
+    nullptr, st.st_size,
+    writable ? PROT_READ | PROT_WRITE : PROT_READ,
+    writable ? MAP_SHARED : MAP_PRIVATE,
+    fd, 0
+  );
+  close(fd);
+
+  if (buffer == MAP_FAILED) {
+    debug("Failed to map '%s' (errno: %d)", filename.c_str(), errno);
+    return;
+  }
+
+  m_buffer = static_cast<uint8_t*>(buffer);
+  m_size = st.st_size;
+}
+
+xvm::bus::device::MappedFile::~MappedFile() {
+  if (m_buffer) {
+    munmap(m_buffer, m_size);
+  }
+  m_buffer = nullptr;
+}
+
+bool xvm::bus::device::MappedFile::isOpen() const {
+  return m_buffer != nullptr;
+}
+
+bool xvm::bus::device::MappedFile::isWritable() const {
+  return m_writable;
+}
+
+size_t xvm::bus::device::MappedFile::getSize() {
+  return m_size;
+}
+
+uint8_t* xvm::bus::device::MappedFile::getBuffer() {
+  return m_buffer;
+}
+
+uint8_t xvm::bus::device::MappedFile::read(size_t address) {
+  size_t offset = address - m_baseAddr;
+  return offset < m_size ? m_buffer[offset] : 0;
+}
+
+void xvm::bus::device::MappedFile::write(size_t address, uint8_t value) {
+  size_t offset = address - m_baseAddr;
+  if (!m_writable || offset >= m_size) {
+    error("Write to read-only mapped file at 0x%zx", address);
+    return;
+  }
+  m_buffer[offset] = value;
+}
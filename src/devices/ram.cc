@@ -1,28 +1,99 @@
 #include <xvm/devices/ram.h>
+#include <xvm/log.h>
 
-#include <cstdio>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
 
-xvm::bus::device::RAM::RAM(size_t size, size_t base) : Device(XVM_BUS_DEV_RAM_NAME), m_size(size), m_baseAddr(base) {
-  m_buffer = new uint8_t[size] {0};
+static size_t pageAlign(size_t size) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  return (size + page - 1) / page * page;
+}
+
+xvm::bus::device::RAM::RAM(size_t size, size_t base, size_t maxSize, bool hugePages)
+  : Device(XVM_BUS_DEV_RAM_NAME), m_size(0), m_maxSize(pageAlign(std::max(size, maxSize))), m_baseAddr(base) {
+  hugePages = hugePages && m_maxSize >= XVM_RAM_HUGE_PAGE_SIZE;
+
+  // Huge pages need an aligned reservation, over-reserve and trim
+  size_t reserve = m_maxSize + (hugePages ? XVM_RAM_HUGE_PAGE_SIZE : 0);
+
+  void* buffer = mmap(nullptr, reserve, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (buffer == MAP_FAILED) {
+    error("Failed to reserve %zu bytes of RAM: %s", reserve, strerror(errno));
+    m_maxSize = 0;
+    return;
+  }
+  m_buffer = static_cast<uint8_t*>(buffer);
+
+  if (hugePages) {
+    uintptr_t addr = reinterpret_cast<uintptr_t>(buffer);
+    uintptr_t aligned = (addr + XVM_RAM_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(XVM_RAM_HUGE_PAGE_SIZE - 1);
+    if (aligned > addr) {
+      munmap(buffer, aligned - addr);
+    }
+    if (aligned + m_maxSize < addr + reserve) {
+      munmap(reinterpret_cast<void*>(aligned + m_maxSize), addr + reserve - aligned - m_maxSize);
+    }
+    m_buffer = reinterpret_cast<uint8_t*>(aligned);
+#ifdef MADV_HUGEPAGE
+    madvise(m_buffer, m_maxSize, MADV_HUGEPAGE);
+#endif
+  }
+
+  m_valid = resize(size);
+  if (!m_valid) {
+    error("Failed to commit %zu bytes of RAM", size);
+  }
 }
 
 xvm::bus::device::RAM::~RAM() {
-  delete [] m_buffer;
+  if (m_buffer) {
+    munmap(m_buffer, m_maxSize);
+  }
   m_buffer = nullptr;
 }
 
+bool xvm::bus::device::RAM::resize(size_t size) {
+  if (!m_buffer || size > m_maxSize || size < m_size) {
+    return false;
+  }
+  if (mprotect(m_buffer, pageAlign(size), PROT_READ | PROT_WRITE) != 0) {
+    return false;
+  }
+  m_size = size;
+  return true;
+}
+
+bool xvm::bus::device::RAM::isValid() const {
+  return m_valid;
+}
+
 size_t xvm::bus::device::RAM::getSize() {
   return m_size;
 }
 
+size_t xvm::bus::device::RAM::getMaxSize() {
+  return m_maxSize;
+}
+
 uint8_t* xvm::bus::device::RAM::getBuffer() {
   return m_buffer;
 }
 
+// Only the first m_size bytes are accessible, the rest of the reservation
+// isn't mapped yet
 uint8_t xvm::bus::device::RAM::read(size_t address) {
-  return m_buffer[address-m_baseAddr];
+  size_t offset = address - m_baseAddr;
+  return offset < m_size ? m_buffer[offset] : 0;
 }
 
 void xvm::bus::device::RAM::write(size_t address, uint8_t value) {
-  m_buffer[address-m_baseAddr] = value;
+  size_t offset = address - m_baseAddr;
+  if (offset >= m_size) {
+    error("Attempted write outside of RAM at 0x%zx", address);
+    return;
+  }
+  m_buffer[offset] = value;
 }
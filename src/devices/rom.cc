@@ -0,0 +1,80 @@
+#include <xvm/devices/rom.h>
+#include <xvm/log.h>
+
+#include <unordered_map>
+#include <cstring>
+#include <mutex>
+
+namespace {
+
+std::mutex g_imagesMutex;
+std::unordered_multimap<size_t, std::weak_ptr<const std::vector<uint8_t>>> g_images;
+
+size_t hashBytes(const uint8_t* data, size_t size) {
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+} /* namespace */
+
+xvm::bus::device::ROM::ROM(const uint8_t* data, size_t size, size_t base)
+  : ROM(share(data, size), base) {}
+
+xvm::bus::device::ROM::ROM(Image image, size_t base)
+  : Device(XVM_BUS_DEV_ROM_NAME), m_image(std::move(image)), m_baseAddr(base) {}
+
+size_t xvm::bus::device::ROM::getSize() const {
+  return m_image->size();
+}
+
+const uint8_t* xvm::bus::device::ROM::getBuffer() const {
+  return m_image->data();
+}
+
+const xvm::bus::device::ROM::Image& xvm::bus::device::ROM::getImage() const {
+  return m_image;
+}
+
+uint8_t xvm::bus::device::ROM::read(size_t address) {
+  size_t offset = address - m_baseAddr;
+  return offset < m_image->size() ? (*m_image)[offset] : 0;
+}
+
+void xvm::bus::device::ROM::setWriteHandler(WriteHandler handler) {
+  m_onWrite = std::move(handler);
+}
+
+void xvm::bus::device::ROM::write(size_t address, uint8_t) {
+  error("Attempted write into read-only memory at 0x%zx", address);
+  if (m_onWrite) {
+    m_onWrite(address);
+  }
+}
+
+xvm::bus::device::ROM::Image xvm::bus::device::ROM::share(const uint8_t* data, size_t size) {
+  size_t hash = hashBytes(data, size);
+
+  std::lock_guard<std::mutex> lock(g_imagesMutex);
+
+  auto range = g_images.equal_range(hash);
+  for (auto itr = range.first; itr != range.second; ) {
+    Image image = itr->second.lock();
+    if (!image) {
+      itr = g_images.erase(itr);
+      continue;
+    }
+    if (image->size() == size && memcmp(image->data(), data, size) == 0) {
+      return image;
+    }
+    itr++;
+  }
+
+  Image image = std::make_shared<const std::vector<uint8_t>>(data, data + size);
+  g_images.emplace(hash, image);
+  return image;
+}
@@ -0,0 +1,191 @@
+#include <xvm/dynamic.h>
+#include <xvm/vm.h>
+#include <xvm/config.h>
+#include <xvm/utils.h>
+#include <xvm/syscalls.h>
+#include <xvm/bytecode.h>
+#include <xvm/devices/ram.h>
+#include <xvm/devices/rom.h>
+#include <xvm/log.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace xvm;
+
+static u32 alignUp(u32 value, u32 alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Filename as linked, or its base name in one of dynamic-lib-path folders
+static std::string findLibrary(const std::string& filename) {
+  if (isFileExists(filename)) {
+    return filename;
+  }
+
+  std::string name = filename.substr(filename.find_last_of('/') + 1);
+  for (const auto& folder : splitString(config::get("dynamic-lib-path"), ':')) {
+    if (!folder.empty() && isFileExists(folder + "/" + name)) {
+      return folder + "/" + name;
+    }
+  }
+
+  return "";
+}
+
+int xvm::DynamicLinker::load(VM& vm, const RunInfo& runInfo) {
+  m_runInfo = runInfo;
+  m_resolved.assign(runInfo.imports.size(), -1);
+
+  if ((size_t) config::asInt("ram-max-size") > XVM_DYNAMIC_BASE) {
+    error("Dynamic libraries need ram-max-size not above 0x%x", XVM_DYNAMIC_BASE);
+    return 1;
+  }
+
+  u32 base = XVM_DYNAMIC_BASE;
+
+  for (const auto& name : runInfo.libraries) {
+    std::string filename = findLibrary(name);
+    if (filename.empty()) {
+      error("Dynamic library '%s' not found", name.c_str());
+      return 1;
+    }
+
+    Executable library = Executable::fromFile(filename);
+    if (library.magic != XVM_MAGIC || !library.hasSection("code") || !library.hasSection("symbols")) {
+      error("'%s' is not a dynamic library", filename.c_str());
+      return 1;
+    }
+
+    if (!(library.flags & (u32) ExecutableFlags::PIC)) {
+      error("'%s' isn't position independent, link it with pic set", filename.c_str());
+      return 1;
+    }
+
+    if (library.hasSection("runinfo")) {
+      error("'%s' needs dynamic libraries of its own, that isn't supported", filename.c_str());
+      return 1;
+    }
+
+    // Nothing patches mentions left in a library, they would point nowhere
+    if (library.hasSection("relocations")
+        && !RelocationTable::fromSection(library.getSection("relocations")).relocations.empty()) {
+      error("'%s' has unresolved relocations, that isn't supported", filename.c_str());
+      return 1;
+    }
+
+    const auto& code = library.getSection("code");
+    if (code.length() == 0) {
+      error("'%s' has no code", filename.c_str());
+      return 1;
+    }
+
+    // Bus ranges include their end address, hence the -1
+    auto rom = new bus::device::ROM(code.bytes(), code.length(), base);
+    rom->setWriteHandler([&vm](size_t) { vm.stop(); });
+    if (!vm.getBus().bind(base, code.length() - 1, rom, true)) {
+      delete rom;
+      error("Failed to map '%s' at 0x%x", filename.c_str(), base);
+      return 1;
+    }
+
+    u32 dataBegin = -1U, imageEnd = code.length();
+    for (const auto& section : library.sections) {
+      if (section.type == SectionType::DATA || section.type == SectionType::BSS) {
+        dataBegin = std::min(dataBegin, section.addr);
+        imageEnd = std::max(imageEnd, (u32) (section.addr + section.memoryLength()));
+      }
+    }
+
+    if (dataBegin != -1U && imageEnd > dataBegin) {
+      auto ram = new bus::device::RAM(imageEnd - dataBegin, base + dataBegin);
+      if (!ram->isValid() || !vm.getBus().bind(base + dataBegin, imageEnd - dataBegin - 1, ram, true)) {
+        delete ram;
+        error("Failed to map data of '%s' at 0x%x", filename.c_str(), base + dataBegin);
+        return 1;
+      }
+
+      for (const auto& section : library.sections) {
+        if (section.type == SectionType::DATA) {
+          std::memcpy(ram->getBuffer() + (section.addr - dataBegin), section.bytes(), section.length());
+        }
+      }
+    }
+
+    auto symbols = SymbolTable::fromSection(library.getSection("symbols"));
+    for (const auto& symbol : symbols.symbols) {
+      if (symbol.isExtern()) {
+        continue;
+      }
+
+      vm.getSymbols().addSymbol(base + symbol.address, symbol.label, symbol.flags, symbol.size);
+
+      // First library exporting a label wins
+      if (!symbol.isLocal() && !symbol.isData() && !symbol.isBss()) {
+        m_exports.emplace(symbol.label, base + symbol.address);
+      }
+    }
+
+    debug("Loaded '%s' at 0x%x", filename.c_str(), base);
+    m_libraries.push_back({filename, base});
+    base = alignUp(base + imageEnd + 1, XVM_DYNAMIC_ALIGN);
+  }
+
+  if (!config::asBool("dynamic-lazy")) {
+    for (u32 i = 0; i < m_runInfo.imports.size(); i++) {
+      if (resolve(vm, i) < 0) {
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+i32 xvm::DynamicLinker::resolve(VM& vm, u32 index) {
+  if (index >= m_resolved.size()) {
+    error("Bad dynamic import %u", index);
+    return -1;
+  }
+
+  if (m_resolved[index] >= 0) {
+    return m_resolved[index];
+  }
+
+  const auto& import = m_runInfo.imports[index];
+  auto itr = m_exports.find(import.label);
+  if (itr == m_exports.end()) {
+    error("Unresolved dynamic symbol '%s'", import.label.c_str());
+    return -1;
+  }
+
+  m_resolved[index] = itr->second;
+  debug("Bound '%s' to 0x%x", import.label.c_str(), itr->second);
+
+  auto device = vm.getBus().getDeviceByAddress(import.stub);
+  if (device && device->getName() != XVM_BUS_DEV_ROM_NAME) {
+    abi::N32 n;
+    n._i32 = itr->second;
+    vm.getBus().write(import.stub, abi::encodeFlags(abi::IMM, abi::_NONE));
+    vm.getBus().write(import.stub + 1, abi::JUMP);
+    for (int i = 0; i < 4; i++) {
+      vm.getBus().write(import.stub + 2 + i, n._u8[i]);
+    }
+  }
+
+  return itr->second;
+}
+
+void xvm::DynamicLinker::encodeStub(u8* code, u32 index) {
+  abi::N32 n;
+
+  code[0] = abi::encodeFlags(abi::IMM, abi::_NONE);
+  code[1] = abi::PUSH;
+  n._u32 = index;
+  std::copy_n(n._u8, 4, code + 2);
+
+  code[6] = abi::encodeFlags(abi::IMM, abi::_NONE);
+  code[7] = abi::SYSCALL;
+  n._u32 = VMX_SYSCALL_DL_RESOLVE;
+  std::copy_n(n._u8, 4, code + 8);
+}
@@ -1,20 +1,78 @@
 #include <xvm/executable.h>
+#include <xvm/checksum.h>
+#include <xvm/compress.h>
 #include <xvm/bytecode.h>
 #include <xvm/config.h>
 #include <xvm/log.h>
 #include <xvm/abi.h>
 
+#include <algorithm>
+#include <cstring>
 #include <cstdio>
 #include <cctype>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 
 xvm::Executable::Section::Section(SectionType type, std::string label, std::vector<u8> data, u32 addr)
   : magic(XVM_SECTION_MAGIC), type(type), addr(addr), checksum(0), label(label), data(data) {
 }
 
+bool xvm::Executable::Section::isCompressed() const {
+  return view && flags & (u32) SectionFlags::COMPRESSED;
+}
+
+const u8* xvm::Executable::Section::bytes() const {
+  return isCompressed() ? inflated.data() : storedBytes();
+}
+
+size_t xvm::Executable::Section::length() const {
+  return isCompressed() ? rawSize : storedLength();
+}
+
+size_t xvm::Executable::Section::memoryLength() const {
+  return type == SectionType::BSS ? rawSize : length();
+}
+
+const u8* xvm::Executable::Section::storedBytes() const {
+  return view ? view : data.data();
+}
+
+size_t xvm::Executable::Section::storedLength() const {
+  return view ? viewSize : data.size();
+}
+
+bool xvm::Executable::Section::inflate() {
+  if (!isCompressed() || inflated.size() == rawSize) {
+    return true;
+  }
+  inflated.resize(rawSize);
+  return lz::decompress(view, viewSize, inflated.data(), rawSize);
+}
+
+// Writes length() bytes of section contents into destination,
+// decompressing them on the way if needed
+bool xvm::Executable::Section::unpack(u8* destination) const {
+  if (isCompressed()) {
+    return lz::decompress(view, viewSize, destination, rawSize);
+  }
+  memcpy(destination, storedBytes(), storedLength());
+  return true;
+}
+
 size_t xvm::Executable::Section::size() const {
-  return label.size() + data.size() + 12;
+  return label.size() + length() + 12;
+}
+
+u32 xvm::Executable::Section::computeChecksum() const {
+  return crc32c(storedBytes(), storedLength());
+}
+
+bool xvm::Executable::Section::verifyChecksum() const {
+  return computeChecksum() == checksum;
 }
 
 std::vector<u8> xvm::Executable::Section::toBytes() const {
@@ -34,13 +92,13 @@ std::vector<u8> xvm::Executable::Section::toBytes() const {
   n._u32 = (u32) type;
   push_u32();
 
-  n._u32 = data.size();
+  n._u32 = length();
   push_u32();
 
-  n._u32 = checksum;
+  n._u32 = crc32c(bytes(), length());
   push_u32();
 
-  buffer.insert(buffer.end(), data.begin(), data.end());
+  buffer.insert(buffer.end(), bytes(), bytes() + length());
 
   return buffer;
 }
@@ -64,17 +122,21 @@ xvm::Executable::Section xvm::Executable::Section::fromBuffer(const u8* data, si
 
   offset += 4;
 
-  section.data = std::vector(data + offset, data + offset + size);
+  section.view = data + offset;
+  section.viewSize = size;
 
   return section;
 }
 
 std::vector<std::string> xvm::Executable::Section::getStringLine() const {
-  return {label, sectionTypeToString(type), std::to_string(data.size())};
+  char buffer[32] = {0};
+  snprintf(buffer, sizeof buffer, "0x%x", addr);
+
+  return {label, sectionTypeToString(type), addr == -1U ? "-" : buffer, std::to_string(memoryLength()), std::to_string(storedLength())};
 }
 
 const std::vector<std::string> xvm::Executable::Section::getFieldNames() {
-  return {"Label", "Type", "Size"};
+  return {"Label", "Type", "Addr", "Size", "Stored"};
 }
 
 bool xvm::SymbolTable::Symbol::isLabel() const {
@@ -93,13 +155,26 @@ bool xvm::SymbolTable::Symbol::isExtern() const {
   return flags & (u16) SymbolFlags::EXTERN;
 }
 
+bool xvm::SymbolTable::Symbol::isLocal() const {
+  return flags & (u16) SymbolFlags::LOCAL;
+}
+
+bool xvm::SymbolTable::Symbol::isBss() const {
+  return flags & (u16) SymbolFlags::BSS;
+}
+
+bool xvm::SymbolTable::Symbol::isData() const {
+  return flags & (u16) SymbolFlags::DATA;
+}
+
 std::vector<std::string> xvm::SymbolTable::Symbol::getStringLine() const {
   char buffer[32] = {0};
   snprintf(buffer, sizeof buffer, "0x%x", address);
 
   return {
     buffer,
-    std::string(isLabel() ? "L" : "-") + (isProcedure() ? "P" : "-") + (isVariable() ? "V" : "-") + (isExtern() ? "X" : "-"),
+    std::string(isLabel() ? "L" : "-") + (isProcedure() ? "P" : "-") + (isVariable() ? "V" : "-") + (isExtern() ? "X" : "-")
+      + (isLocal() ? "l" : "-") + (isData() ? "D" : isBss() ? "B" : "-"),
     std::to_string(size),
     label
   };
@@ -113,40 +188,92 @@ void xvm::SymbolTable::addSymbol(i32 address, const std::string& label, u16 flag
   symbols.push_back({address, flags, size, label});
 }
 
+void xvm::SymbolTable::reindex() const {
+  m_labelIndex.clear();
+  m_addressIndex.resize(symbols.size());
+
+  for (size_t i = 0; i < symbols.size(); i++) {
+    m_labelIndex.emplace(symbols[i].label, i);
+    m_addressIndex[i] = i;
+  }
+
+  std::stable_sort(m_addressIndex.begin(), m_addressIndex.end(),
+    [this](size_t lhs, size_t rhs) { return symbols[lhs].address < symbols[rhs].address; });
+
+  m_indexedSize = symbols.size();
+}
+
+const xvm::SymbolTable::Symbol* xvm::SymbolTable::findByAddress(i32 address) const {
+  if (m_indexedSize != symbols.size()) {
+    reindex();
+  }
+
+  auto itr = std::lower_bound(m_addressIndex.begin(), m_addressIndex.end(), address,
+    [this](size_t index, i32 address) { return symbols[index].address < address; });
+
+  if (itr == m_addressIndex.end() || symbols[*itr].address != address) {
+    return nullptr;
+  }
+  return &symbols[*itr];
+}
+
+const xvm::SymbolTable::Symbol* xvm::SymbolTable::findByLabel(const std::string& label) const {
+  if (m_indexedSize != symbols.size()) {
+    reindex();
+  }
+
+  auto itr = m_labelIndex.find(label);
+  return itr != m_labelIndex.end() ? &symbols[itr->second] : nullptr;
+}
+
+xvm::SymbolTable::Symbol* xvm::SymbolTable::findByAddress(i32 address) {
+  return const_cast<Symbol*>(static_cast<const SymbolTable*>(this)->findByAddress(address));
+}
+
+xvm::SymbolTable::Symbol* xvm::SymbolTable::findByLabel(const std::string& label) {
+  return const_cast<Symbol*>(static_cast<const SymbolTable*>(this)->findByLabel(label));
+}
+
+const xvm::SymbolTable::Symbol* xvm::SymbolTable::findNearest(i32 address) const {
+  if (m_indexedSize != symbols.size()) {
+    reindex();
+  }
+
+  auto itr = std::upper_bound(m_addressIndex.begin(), m_addressIndex.end(), address,
+    [this](i32 address, size_t index) { return address < symbols[index].address; });
+
+  if (itr == m_addressIndex.begin()) {
+    return nullptr;
+  }
+
+  // First one added among symbols sharing that address
+  i32 nearest = symbols[*--itr].address;
+  while (itr != m_addressIndex.begin() && symbols[*(itr-1)].address == nearest) {
+    itr--;
+  }
+  return &symbols[*itr];
+}
+
 xvm::SymbolTable::Symbol& xvm::SymbolTable::getByAddress(i32 address) {
-  for (auto& symbol : symbols) {
-    if (symbol.address == address) {
-      return symbol;
-    }
+  if (Symbol* symbol = findByAddress(address)) {
+    return *symbol;
   }
   throw "No such symbol";
 }
 
 xvm::SymbolTable::Symbol& xvm::SymbolTable::getByLabel(const std::string& label) {
-  for (auto& symbol : symbols) {
-    if (symbol.label == label) {
-      return symbol;
-    }
+  if (Symbol* symbol = findByLabel(label)) {
+    return *symbol;
   }
   throw "No such symbol";
 }
 
 bool xvm::SymbolTable::hasAddress(i32 address) const {
-  for (auto& symbol : symbols) {
-    if (symbol.address == address) {
-      return true;
-    }
-  }
-  return false;
+  return findByAddress(address) != nullptr;
 }
 
 bool xvm::SymbolTable::hasLabel(const std::string& label) const {
-  for (auto& symbol : symbols) {
-    if (symbol.label == label) {
-      return true;
-    }
-  }
-  return false;
+  return findByLabel(label) != nullptr;
 }
 
 xvm::Executable::Section xvm::SymbolTable::toSection(const std::string& label) const {
@@ -182,21 +309,23 @@ xvm::SymbolTable xvm::SymbolTable::fromSection(const Executable::Section& sectio
   SymbolTable table;
   abi::N32 n;
 
-  for (int i = 0; i < section.data.size(); ) {
+  const u8* data = section.bytes();
+
+  for (int i = 0; i < section.length(); ) {
     Symbol symbol;
 
-    readInt32(n, section.data.data(), i);
+    readInt32(n, data, i);
     symbol.address = n._i32;
 
-    readInt16(n, section.data.data(), i += 4);
+    readInt16(n, data, i += 4);
     symbol.flags = n._u16[0];
 
-    readInt16(n, section.data.data(), i += 2);
+    readInt16(n, data, i += 2);
     symbol.size = n._u16[0];
 
     i += 2;
 
-    for (char c = section.data[i++]; c != '\0'; c = section.data[i++]) {
+    for (char c = data[i++]; c != '\0'; c = data[i++]) {
       symbol.label.push_back(c);
     }
 
@@ -242,21 +371,23 @@ xvm::RelocationTable xvm::RelocationTable::fromSection(const Executable::Section
   RelocationTable table;
   abi::N32 n;
 
-  for (int i = 0; i < section.data.size(); ) {
+  const u8* data = section.bytes();
+
+  for (int i = 0; i < section.length(); ) {
     RelocationEntry entry;
 
-    readInt32(n, section.data.data(), i);
+    readInt32(n, data, i);
     int mentionsSize = n._u32;
 
     i += 4;
 
     for (int j = 0; j < mentionsSize; j++) {
-      readInt32(n, section.data.data(), i);
+      readInt32(n, data, i);
       i += 4;
-      entry.mentions.push_back({n._i32, section.data[i++]});
+      entry.mentions.push_back({n._i32, data[i++]});
     }
 
-    for (char c = section.data[i++]; c != '\0'; c = section.data[i++]) {
+    for (char c = data[i++]; c != '\0'; c = data[i++]) {
       entry.label.push_back(c);
     }
 
@@ -266,6 +397,141 @@ xvm::RelocationTable xvm::RelocationTable::fromSection(const Executable::Section
   return table;
 }
 
+xvm::Executable::Section xvm::RunInfo::toSection(const std::string& label) const {
+  Executable::Section section;
+  abi::N32 n;
+
+  auto push_u32 = [&n, &section] {
+    for (int i = 0; i < 4; i++)
+      section.data.push_back(n._u8[i]);
+  };
+
+  auto push_string = [&section](const std::string& str) {
+    section.data.insert(section.data.end(), str.begin(), str.end());
+    section.data.push_back(0);
+  };
+
+  section.label = label;
+  section.type = SectionType::RUNINFO;
+  section.checksum = 0;
+
+  n._u32 = libraries.size();
+  push_u32();
+  for (const auto& library : libraries) {
+    push_string(library);
+  }
+
+  n._u32 = imports.size();
+  push_u32();
+  for (const auto& import : imports) {
+    n._u32 = import.stub;
+    push_u32();
+    push_string(import.label);
+  }
+
+  return section;
+}
+
+xvm::RunInfo xvm::RunInfo::fromSection(const Executable::Section& section) {
+  RunInfo info;
+  abi::N32 n;
+
+  const u8* data = section.bytes();
+  int length = section.length();
+  int i = 0;
+
+  auto read_string = [&]() {
+    std::string str;
+    while (i < length && data[i] != '\0') {
+      str.push_back(data[i++]);
+    }
+    i++;
+    return str;
+  };
+
+  if (length < 4) {
+    return info;
+  }
+
+  readInt32(n, data, i);
+  i += 4;
+  for (u32 j = 0; j < n._u32 && i < length; j++) {
+    info.libraries.push_back(read_string());
+  }
+
+  if (i + 4 > length) {
+    return info;
+  }
+
+  readInt32(n, data, i);
+  i += 4;
+  for (u32 j = 0, count = n._u32; j < count && i + 4 <= length; j++) {
+    Import import;
+    readInt32(n, data, i);
+    i += 4;
+    import.stub = n._u32;
+    import.label = read_string();
+    info.imports.push_back(import);
+  }
+
+  return info;
+}
+
+xvm::Executable::Section xvm::ObjectTable::toSection(const std::string& label) const {
+  Executable::Section section;
+  abi::N32 n;
+
+  auto push_u32 = [&n, &section] {
+    for (int i = 0; i < 4; i++)
+      section.data.push_back(n._u8[i]);
+  };
+
+  section.label = label;
+  section.type = SectionType::OBJECTS;
+  section.checksum = 0;
+
+  n._u32 = objects.size();
+  push_u32();
+  for (const auto& object : objects) {
+    n._u32 = object.codeBegin;
+    push_u32();
+    n._u32 = object.hash;
+    push_u32();
+  }
+
+  return section;
+}
+
+u32 xvm::ObjectTable::findHash(u32 address) const {
+  auto itr = std::upper_bound(objects.begin(), objects.end(), address,
+    [](u32 address, const Object& object) { return address < object.codeBegin; });
+  return itr == objects.begin() ? 0 : (itr - 1)->hash;
+}
+
+xvm::ObjectTable xvm::ObjectTable::fromSection(const Executable::Section& section) {
+  ObjectTable table;
+  abi::N32 n;
+
+  const u8* data = section.bytes();
+  size_t length = section.length();
+
+  if (length < 4) {
+    return table;
+  }
+
+  readInt32(n, data, 0);
+  for (size_t i = 4, count = n._u32; count > 0 && i + 8 <= length; i += 8, count--) {
+    Object object;
+    readInt32(n, data, i);
+    object.codeBegin = n._u32;
+    readInt32(n, data, i + 4);
+    object.hash = n._u32;
+    table.objects.push_back(object);
+  }
+
+  return table;
+}
+
 bool xvm::Executable::hasSection(const std::string& label) const {
   for (auto& section : sections) {
     if (section.label == label) {
@@ -306,15 +572,18 @@ void xvm::Executable::disassemble() const {
     table = SymbolTable::fromSection(getSection("symbols"));
   }
 
-  for (int i = 0; i < code.data.size(); ) {
-    if (hasSymbols && table.hasAddress(i)) {
-      const auto& symbol = table.getByAddress(i);
+  const u8* data = code.bytes();
+
+  for (int i = 0; i < code.length(); ) {
+    const SymbolTable::Symbol* found = hasSymbols ? table.findByAddress(i) : nullptr;
+    if (found) {
+      const auto& symbol = *found;
       if (symbol.isVariable()) {
         printf("0x%04x | %s | ", i, symbol.label.c_str());
         char* buffer = new char[symbol.size+1] {0};
         for (int idx = 0; idx < symbol.size; i++) {
-          printf("%02x ", code.data[i]);
-          buffer[idx++] = isprint(code.data[i]) ? code.data[i] : '.';
+          printf("%02x ", data[i]);
+          buffer[idx++] = isprint(data[i]) ? data[i] : '.';
         }
         printf("| %s\n", buffer);
         delete [] buffer;
@@ -322,7 +591,7 @@ void xvm::Executable::disassemble() const {
       }
     }
 
-    i = xvm::abi::disassembleInstruction(code.data.data(), i);
+    i = xvm::abi::disassembleInstruction(data, i);
   }
 }
 
@@ -341,15 +610,118 @@ std::vector<u8> xvm::Executable::toBytes() const {
   n._u32 = version;
   push_u32();
 
-  n._u32 = flags;
+  if (format == XVM_FORMAT_V1) {
+    n._u32 = (flags & ~(u32) ExecutableFlags::DIRECTORY) | (u32) ExecutableFlags::CHECKSUMS;
+    push_u32();
+
+    n._u32 = sections.size();
+    push_u32();
+
+    for (auto& section : sections) {
+      auto section_bytes = section.toBytes();
+      buffer.insert(buffer.end(), section_bytes.begin(), section_bytes.end());
+    }
+
+    return buffer;
+  }
+
+  u32 align = XVM_EXE_SECTION_ALIGN;
+  u32 directoryOffset = XVM_EXE_HEADER_SIZE;
+  u32 stringsOffset = directoryOffset + sections.size() * XVM_EXE_DIR_ENTRY_SIZE;
+
+  std::vector<u8> strings;
+  std::vector<u32> labelOffsets;
+  for (auto& section : sections) {
+    labelOffsets.push_back(strings.size());
+    strings.insert(strings.end(), section.label.begin(), section.label.end());
+    strings.push_back(0);
+  }
+
+  // Sections are only stored compressed if that makes them smaller
+  std::vector<std::vector<u8>> compressed(sections.size());
+  if (config::asBool("compress")) {
+    for (size_t i = 0; i < sections.size(); i++) {
+      auto packed = lz::compress(sections[i].bytes(), sections[i].length());
+      if (packed.size() < sections[i].length()) {
+        compressed[i] = std::move(packed);
+      }
+    }
+  }
+
+  auto payload = [&](size_t i) -> std::pair<const u8*, size_t> {
+    if (!compressed[i].empty()) {
+      return {compressed[i].data(), compressed[i].size()};
+    }
+    return {sections[i].bytes(), sections[i].length()};
+  };
+
+  std::vector<u32> dataOffsets;
+  u32 offset = stringsOffset + strings.size();
+  for (size_t i = 0; i < sections.size(); i++) {
+    if (payload(i).second > 0) {
+      offset = (offset + align - 1) / align * align;
+    }
+    dataOffsets.push_back(offset);
+    offset += payload(i).second;
+  }
+
+  n._u32 = flags | (u32) ExecutableFlags::DIRECTORY | (u32) ExecutableFlags::CHECKSUMS;
   push_u32();
 
   n._u32 = sections.size();
   push_u32();
 
-  for (auto& section : sections) {
-    auto section_bytes = section.toBytes();
-    buffer.insert(buffer.end(), section_bytes.begin(), section_bytes.end());
+  n._u32 = XVM_FORMAT_V2;
+  push_u32();
+
+  n._u32 = directoryOffset;
+  push_u32();
+
+  n._u32 = align;
+  push_u32();
+
+  n._u32 = 0;
+  push_u32();
+
+  for (size_t i = 0; i < sections.size(); i++) {
+    const auto& section = sections[i];
+
+    n._u32 = (u32) section.type;
+    push_u32();
+
+    auto [data, size] = payload(i);
+
+    n._u32 = section.flags & ~(u32) SectionFlags::COMPRESSED;
+    if (!compressed[i].empty()) {
+      n._u32 |= (u32) SectionFlags::COMPRESSED;
+    }
+    push_u32();
+
+    n._u32 = section.addr;
+    push_u32();
+
+    n._u32 = dataOffsets[i];
+    push_u32();
+
+    n._u32 = size;
+    push_u32();
+
+    n._u32 = crc32c(data, size);
+    push_u32();
+
+    n._u32 = labelOffsets[i];
+    push_u32();
+
+    n._u32 = section.memoryLength();
+    push_u32();
+  }
+
+  buffer.insert(buffer.end(), strings.begin(), strings.end());
+
+  for (size_t i = 0; i < sections.size(); i++) {
+    auto [data, size] = payload(i);
+    buffer.resize(std::max<size_t>(buffer.size(), dataOffsets[i]), 0);
+    buffer.insert(buffer.end(), data, data + size);
   }
 
   return buffer;
@@ -369,9 +741,13 @@ void xvm::Executable::toFile(const std::string& filename) const {
   fclose(file);
 }
 
-xvm::Executable xvm::Executable::fromBuffer(const u8* data) {
+xvm::Executable xvm::Executable::fromBuffer(const u8* data, size_t size, bool inflate) {
   Executable exe;
-  
+
+  if (size < 16) {
+    return exe;
+  }
+
   abi::N32 n;
   readInt32(n, data, 0);
   exe.magic = n._u32;
@@ -385,46 +761,151 @@ xvm::Executable xvm::Executable::fromBuffer(const u8* data) {
   readInt32(n, data, 12);
   u32 section_count = n._u32;
 
-  u32 offset = 16;
+  if (!(exe.flags & (u32) ExecutableFlags::DIRECTORY)) {
+    exe.format = XVM_FORMAT_V1;
+
+    u32 offset = 16;
+
+    for (u32 i = 0; i < section_count; i++) {
+      exe.sections.push_back(Section::fromBuffer(data, offset));
+      offset += exe.sections.back().size() + 1;
+    }
+
+    return exe;
+  }
+
+  exe.flags &= ~(u32) ExecutableFlags::DIRECTORY;
+
+  if (size < XVM_EXE_HEADER_SIZE) {
+    error("Corrupted section directory");
+    exe.magic = XVM_BAD_MAGIC;
+    return exe;
+  }
+
+  readInt32(n, data, 16);
+  exe.format = n._u32;
+  if (exe.format != XVM_FORMAT_V2) {
+    error("Unknown executable format %u", exe.format);
+    exe.magic = XVM_BAD_MAGIC;
+    return exe;
+  }
+
+  readInt32(n, data, 20);
+  u32 directoryOffset = n._u32;
+
+  // 64-bit, a large section count must not wrap around past the check
+  u64 stringsOffset = (u64) directoryOffset + (u64) section_count * XVM_EXE_DIR_ENTRY_SIZE;
+  if (stringsOffset > size) {
+    error("Corrupted section directory");
+    exe.magic = XVM_BAD_MAGIC;
+    return exe;
+  }
 
   for (u32 i = 0; i < section_count; i++) {
-    exe.sections.push_back(Section::fromBuffer(data, offset));
-    offset += exe.sections.back().size() + 1;
+    size_t entry = directoryOffset + (size_t) i * XVM_EXE_DIR_ENTRY_SIZE;
+    Section section;
+    section.magic = XVM_SECTION_MAGIC;
+
+    readInt32(n, data, entry);
+    section.type = (SectionType) n._u32;
+
+    readInt32(n, data, entry + 4);
+    section.flags = n._u32;
+
+    readInt32(n, data, entry + 8);
+    section.addr = n._u32;
+
+    readInt32(n, data, entry + 12);
+    u32 dataOffset = n._u32;
+
+    readInt32(n, data, entry + 16);
+    u32 dataSize = n._u32;
+
+    readInt32(n, data, entry + 20);
+    section.checksum = n._u32;
+
+    readInt32(n, data, entry + 24);
+    u32 labelOffset = n._u32;
+
+    readInt32(n, data, entry + 28);
+    section.rawSize = n._u32;
+
+    if ((size_t) dataOffset + dataSize > size || stringsOffset + labelOffset >= size) {
+      error("Corrupted section directory");
+      exe.magic = XVM_BAD_MAGIC;
+      return exe;
+    }
+
+    for (size_t c = stringsOffset + labelOffset; c < size && data[c] != '\0'; c++) {
+      section.label.push_back(data[c]);
+    }
+
+    section.view = data + dataOffset;
+    section.viewSize = dataSize;
+
+    if (section.isCompressed()) {
+      // Raw size is only trusted as far as the stream could expand
+      if (section.rawSize > (u64) dataSize * XVM_LZ_MAX_RATIO) {
+        error("Corrupted section directory");
+        exe.magic = XVM_BAD_MAGIC;
+        return exe;
+      }
+
+      if (inflate && exe.flags & (u32) ExecutableFlags::CHECKSUMS && config::asBool("verify-checksums")
+          && !section.verifyChecksum()) {
+        error("Checksum mismatch in section '%s'", section.label.c_str());
+        exe.magic = XVM_BAD_MAGIC;
+        return exe;
+      }
+
+      if (inflate && !section.inflate()) {
+        error("Failed to decompress section '%s'", section.label.c_str());
+        exe.magic = XVM_BAD_MAGIC;
+        return exe;
+      }
+    }
+
+    exe.sections.push_back(std::move(section));
   }
 
   return exe;
 }
 
-xvm::Executable xvm::Executable::fromFile(const std::string& filename) {
+// The file is mapped rather than read, sections are views into the
+// mapping which lives as long as the executable (or any copy of it)
+xvm::Executable xvm::Executable::fromFile(const std::string& filename, bool inflate) {
   Executable exe;
-  FILE* file = fopen(filename.c_str(), "rb");
-  if (!file) {
-    if (errno == 2) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1) {
+    if (errno == ENOENT) {
       error("No such file or directory: '%s'", filename.c_str());
-      return exe;
     } else {
       error("Failed to open '%s'", filename.c_str());
-      return exe;
     }
+    return exe;
   }
 
-  fseek(file, 0, SEEK_END);
-  size_t size = ftell(file);
-  rewind(file);
-
-  u8* data = new u8[size];
-  if (fread(data, 1, size, file) != size) {
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 16) {
     error("Error: couldn't read file (errno=%d)", errno);
-    delete [] data;
-    fclose(file);
+    close(fd);
     return exe;
   }
 
-  fclose(file);
+  size_t size = st.st_size;
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    error("Error: couldn't map file (errno=%d)", errno);
+    return exe;
+  }
 
-  exe = Executable::fromBuffer(data);
+  exe = Executable::fromBuffer(static_cast<const u8*>(data), size, inflate);
+  exe.backing = std::shared_ptr<const u8>(static_cast<const u8*>(data), [size](const u8* ptr) {
+    munmap(const_cast<u8*>(ptr), size);
+  });
 
-  delete [] data;
   return exe;
 }
 
@@ -434,6 +915,9 @@ std::string xvm::sectionTypeToString(SectionType type) {
     case SectionType::DATA:        return "data";
     case SectionType::SYMBOLS:     return "symbols";
     case SectionType::RELOCATIONS: return "relocations";
+    case SectionType::RUNINFO:     return "runinfo";
+    case SectionType::BSS:         return "bss";
+    case SectionType::OBJECTS:     return "objects";
     default:                       return "<error>";
   }
 }
@@ -0,0 +1,149 @@
+#include <xvm/heap.h>
+
+static int sizeClass(u32 size) {
+  int index = 0;
+  while (index < XVM_HEAP_CLASS_COUNT && (1U << (index + XVM_HEAP_MIN_CLASS_SHIFT)) < size) {
+    index++;
+  }
+  return index;
+}
+
+static u32 alignUp(u32 value, u32 alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+void xvm::Heap::initialize(u32 begin, u32 end) {
+  m_begin = alignUp(begin ? begin : 1, 1U << XVM_HEAP_MIN_CLASS_SHIFT); // 0 is reserved for null
+  m_end = end;
+  m_top = m_begin;
+
+  for (auto& list : m_freeLists) {
+    list.clear();
+  }
+  m_largeFree.clear();
+  m_largeFreeRuns.clear();
+  m_blocks.clear();
+}
+
+void xvm::Heap::extend(u32 end) {
+  if (end > m_end) {
+    m_end = end;
+  }
+}
+
+u32 xvm::Heap::allocate(u32 size) {
+  if (size == 0) {
+    return 0;
+  }
+
+  u32 address = 0;
+  int index = sizeClass(size);
+
+  if (index < XVM_HEAP_CLASS_COUNT) {
+    size = 1U << (index + XVM_HEAP_MIN_CLASS_SHIFT);
+    auto& list = m_freeLists[index];
+    if (!list.empty()) {
+      address = list.back();
+      list.pop_back();
+    } else {
+      address = allocateFresh(size);
+    }
+  } else {
+    size = alignUp(size, XVM_HEAP_LARGE_ALIGN);
+    auto itr = m_largeFree.lower_bound(size);
+    if (itr != m_largeFree.end()) {
+      u32 blockSize = itr->first;
+      address = itr->second;
+      eraseLargeFree(address, blockSize);
+      if (blockSize > size) {
+        insertLargeFree(address + size, blockSize - size);
+      }
+    } else {
+      address = allocateFresh(size);
+    }
+  }
+
+  if (address) {
+    m_blocks[address] = size;
+  }
+
+  return address;
+}
+
+bool xvm::Heap::release(u32 address) {
+  auto itr = m_blocks.find(address);
+  if (itr == m_blocks.end()) {
+    return false;
+  }
+
+  u32 size = itr->second;
+  m_blocks.erase(itr);
+
+  int index = sizeClass(size);
+  if (index < XVM_HEAP_CLASS_COUNT) {
+    m_freeLists[index].push_back(address);
+    return true;
+  }
+
+  auto next = m_largeFreeRuns.find(address + size);
+  if (next != m_largeFreeRuns.end()) {
+    u32 nextSize = next->second;
+    eraseLargeFree(address + size, nextSize);
+    size += nextSize;
+  }
+
+  auto prev = m_largeFreeRuns.lower_bound(address);
+  if (prev != m_largeFreeRuns.begin() && (--prev)->first + prev->second == address) {
+    u32 prevAddress = prev->first;
+    u32 prevSize = prev->second;
+    eraseLargeFree(prevAddress, prevSize);
+    address = prevAddress;
+    size += prevSize;
+  }
+
+  if (address + size == m_top) {
+    m_top = address;
+  } else {
+    insertLargeFree(address, size);
+  }
+
+  return true;
+}
+
+u32 xvm::Heap::getBlockSize(u32 address) const {
+  auto itr = m_blocks.find(address);
+  return itr != m_blocks.end() ? itr->second : 0;
+}
+
+u32 xvm::Heap::getBegin() const {
+  return m_begin;
+}
+
+u32 xvm::Heap::getEnd() const {
+  return m_end;
+}
+
+u32 xvm::Heap::allocateFresh(u32 size) {
+  if (m_top > m_end || m_end - m_top < size) {
+    return 0;
+  }
+  u32 address = m_top;
+  m_top += size;
+  return address;
+}
+
+void xvm::Heap::insertLargeFree(u32 address, u32 size) {
+  m_largeFree.insert({size, address});
+  m_largeFreeRuns[address] = size;
+}
+
+void xvm::Heap::eraseLargeFree(u32 address, u32 size) {
+  auto range = m_largeFree.equal_range(size);
+  for (auto itr = range.first; itr != range.second; itr++) {
+    if (itr->second == address) {
+      m_largeFree.erase(itr);
+      break;
+    }
+  }
+  m_largeFreeRuns.erase(address);
+}
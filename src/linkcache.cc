@@ -0,0 +1,182 @@
+#include <xvm/linkcache.h>
+#include <xvm/checksum.h>
+#include <xvm/version.h>
+#include <xvm/config.h>
+#include <xvm/utils.h>
+#include <xvm/log.h>
+
+#include <fstream>
+#include <iterator>
+
+bool xvm::LinkCache::toFile(const std::string& filename) const {
+  std::vector<u8> buffer;
+  abi::N32 n;
+
+  auto push_u32 = [&n, &buffer](u32 value) {
+    n._u32 = value;
+    for (int i = 0; i < 4; i++)
+      buffer.push_back(n._u8[i]);
+  };
+
+  auto push_str = [&buffer](const std::string& str) {
+    buffer.insert(buffer.end(), str.begin(), str.end());
+    buffer.push_back(0);
+  };
+
+  push_u32(XVM_LINKCACHE_MAGIC);
+  push_u32(XVM_VERSION_CODE);
+  push_u32(options);
+  push_u32(outputHash);
+  push_u32(codeSize);
+  push_u32(dataSize);
+  push_u32(bssSize);
+
+  push_u32(objects.size());
+  for (const auto& object : objects) {
+    push_u32(object.hash);
+    push_u32(object.codeOffset);
+    push_u32(object.codeSlot);
+    push_u32(object.dataOffset);
+    push_u32(object.dataSlot);
+    push_u32(object.bssOffset);
+    push_u32(object.bssSlot);
+  }
+
+  push_u32(globals.size());
+  for (const auto& global : globals) {
+    push_u32(global.second.object);
+    push_u32(global.second.address);
+    push_str(global.first);
+  }
+
+  push_u32(imports.size());
+  for (const auto& import : imports) {
+    push_u32(import.object);
+    push_u32(import.address);
+    push_u32(import.argumentNumber);
+    push_u32(import.addend);
+    push_str(import.label);
+  }
+
+  FILE* file = fopen(filename.c_str(), "wb");
+  if (!file) {
+    error("Failed to open/create '%s'", filename.c_str());
+    return false;
+  }
+
+  fwrite(buffer.data(), 1, buffer.size(), file);
+  fclose(file);
+  return true;
+}
+
+bool xvm::LinkCache::fromFile(const std::string& filename, LinkCache& cache) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+
+  std::vector<u8> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  size_t offset = 0;
+  bool ok = true;
+  abi::N32 n;
+
+  auto read_u32 = [&]() -> u32 {
+    if (offset + 4 > buffer.size()) {
+      ok = false;
+      return 0;
+    }
+    abi::readInt32(n, buffer.data(), offset);
+    offset += 4;
+    return n._u32;
+  };
+
+  auto read_str = [&]() {
+    std::string str;
+    for (; offset < buffer.size() && buffer[offset] != '\0'; offset++) {
+      str.push_back(buffer[offset]);
+    }
+    ok = ok && offset < buffer.size();
+    offset++;
+    return str;
+  };
+
+  if (read_u32() != XVM_LINKCACHE_MAGIC || read_u32() != XVM_VERSION_CODE) {
+    return false;
+  }
+
+  cache.options = read_u32();
+  cache.outputHash = read_u32();
+  cache.codeSize = read_u32();
+  cache.dataSize = read_u32();
+  cache.bssSize = read_u32();
+
+  u32 count = read_u32();
+  for (u32 i = 0; i < count && ok; i++) {
+    Object object;
+    object.hash = read_u32();
+    object.codeOffset = read_u32();
+    object.codeSlot = read_u32();
+    object.dataOffset = read_u32();
+    object.dataSlot = read_u32();
+    object.bssOffset = read_u32();
+    object.bssSlot = read_u32();
+    cache.objects.push_back(object);
+  }
+
+  count = read_u32();
+  for (u32 i = 0; i < count && ok; i++) {
+    Global global;
+    global.object = read_u32();
+    global.address = read_u32();
+    cache.globals[read_str()] = global;
+  }
+
+  count = read_u32();
+  for (u32 i = 0; i < count && ok; i++) {
+    Import import;
+    import.object = read_u32();
+    import.address = read_u32();
+    import.argumentNumber = read_u32();
+    import.addend = read_u32();
+    import.label = read_str();
+    cache.imports.push_back(std::move(import));
+  }
+
+  if (!ok) {
+    warning("Corrupted link cache '%s'", filename.c_str());
+  }
+  return ok;
+}
+
+u32 xvm::LinkCache::objectHash(const Executable& object) {
+  bool hasChecksums = object.flags & (u32) ExecutableFlags::CHECKSUMS;
+  u32 hash = 0;
+
+  for (const auto& section : object.sections) {
+    u32 fields[] = {
+      (u32) section.type,
+      section.addr,
+      (u32) section.memoryLength(),
+      hasChecksums ? section.checksum : section.computeChecksum()
+    };
+    hash = crc32c((const u8*) section.label.data(), section.label.size(), hash);
+    hash = crc32c((const u8*) fields, sizeof fields, hash);
+  }
+
+  return hash;
+}
+
+u32 xvm::LinkCache::optionsHash() {
+  std::string options = config::get("pic") + ";" + config::get("link-shared") + ";" + config::get("dynamic-libs");
+  u32 hash = crc32c((const u8*) options.data(), options.size());
+
+  // Which externs get imported depends on what the libraries export
+  for (const auto& filename : splitString(config::get("dynamic-libs"), ',')) {
+    if (!filename.empty()) {
+      u32 library = objectHash(Executable::fromFile(filename));
+      hash = crc32c((const u8*) &library, sizeof library, hash);
+    }
+  }
+
+  return hash;
+}
@@ -3,126 +3,1103 @@
 #include <xvm/version.h>
 #include <xvm/config.h>
 #include <xvm/utils.h>
+#include <xvm/profiler.h>
+#include <xvm/linkcache.h>
+#include <xvm/dynamic.h>
+#include <xvm/checksum.h>
 #include <xvm/abi.h>
 #include <xvm/log.h>
 
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <iterator>
+#include <fstream>
 #include <cstdlib>
+#include <cstdio>
 
 using namespace xvm;
 
-static void patchAddressingMode(u8* code, i32 labelAddress, i32 mentionAddress, u8 argumentNumber) {
+static u32 alignUp(u32 value, u32 alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+/*
+Objects are split into chunks, starting at each of their code, data and bss
+symbols, before linking.
+
+Garbage collection keeps only chunks reachable from the entry point (start of
+the first object) and symbols flagged ENTRY. Exported symbols are kept too
+when some externs are left unresolved, since output can be linked again then,
+and with link-shared, since output is a dynamic library then.
+A chunk reaches:
+  - chunks its relocation mentions point into (own or global symbols)
+  - next code chunk of the object, unless it ends with jump/tailcall/ret/halt
+
+With link-inline set, calls of leaf procedures not longer than that (straight
+code ending with ret, without mentions or relative arguments) are replaced by
+the procedure's body, also across objects. Procedures inlined everywhere are
+then dropped by garbage collection.
+
+With a profile (see Profiler), code chunks of all objects are laid out
+together, hottest first across objects and never executed ones at the end of
+code. Chunks falling through into each other are moved as one run, entry
+chunk stays first. Objects are merged into one then, its objects section
+tells which object every run of code came from (see ObjectTable).
+
+Chunks are packed into new objects, with symbols, mentions and arguments of
+own mentions moved to new addresses, so link below doesn't need to know
+anything was moved. Extern mentions only hold their addend and are kept as is.
+*/
+namespace {
+
+struct Chunk {
+  SectionType type;
+  u32 begin; // In object
+  u32 end;
+  u32 newBegin = 0;
+  u64 heat = 0; // Instructions executed, from profile
+  bool live = false;
+  bool fallsThrough = false;
+  int inlineLength = -1; // Length of body without ret if chunk can be inlined
+  std::vector<std::pair<u32, i32>> growth; // Inlined call -> bytes added up to it
+
+  Chunk(SectionType type, u32 begin, u32 end) : type(type), begin(begin), end(end) {}
+};
+
+// Code chunks falling through into each other, moved as one
+struct Run {
+  size_t object;
+  size_t first; // Chunks [first, last]
+  size_t last;
+  u64 heat;     // Hottest chunk
+};
+
+// Call replaced with body of callee chunk
+struct Inline {
+  u32 site; // Call instruction
+  u32 object;
+  u32 chunk;
+  bool isTail;
+};
+
+struct ObjectChunks {
+  const Executable::Section* code = nullptr;
+  const Executable::Section* data = nullptr;
+  const Executable::Section* bss = nullptr;
+  SymbolTable symbols;
+  RelocationTable relocations;
+  ObjectTable inputs;        // Objects an already linked input came from
+  std::vector<Chunk> chunks; // Sorted by begin
+  size_t firstChunk = 0;     // Index of first chunk among all objects
+  std::vector<Inline> inlines;        // Sorted by site
+  std::unordered_set<u32> inlinedMentions;
+
+  // Chunk holding address, end of chunk counts as its own
+  int find(u32 address) const {
+    auto itr = std::upper_bound(chunks.begin(), chunks.end(), address,
+      [](u32 address, const Chunk& chunk) { return address < chunk.begin; });
+    if (itr == chunks.begin() || address > (itr-1)->end) {
+      return -1;
+    }
+    return itr - chunks.begin() - 1;
+  }
+
+  u32 remap(u32 address) const {
+    const Chunk& chunk = chunks[find(address)];
+    i32 added = 0;
+    for (const auto& growth : chunk.growth) {
+      if (growth.first >= address) {
+        break;
+      }
+      added = growth.second;
+    }
+    return chunk.newBegin + (address - chunk.begin) + added;
+  }
+
+  u32 sectionAddress(const SymbolTable::Symbol& symbol) const {
+    return symbol.isData() ? data->addr : symbol.isBss() ? bss->addr : 0;
+  }
+};
+
+} /* namespace */
+
+static void splitChunks(ObjectChunks& object) {
+  auto split = [&object](SectionType type, u32 begin, u32 end) {
+    std::vector<u32> bounds = {begin, end};
+    for (const auto& symbol : object.symbols.symbols) {
+      if (symbol.isExtern() || object.sectionAddress(symbol) != begin) {
+        continue;
+      }
+      if ((u32) symbol.address > begin && (u32) symbol.address < end) {
+        bounds.push_back(symbol.address);
+      }
+    }
+
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    for (size_t i = 0; i + 1 < bounds.size(); i++) {
+      object.chunks.emplace_back(type, bounds[i], bounds[i+1]);
+    }
+  };
+
+  split(SectionType::CODE, 0, object.code->length());
+  if (object.data) {
+    split(SectionType::DATA, object.data->addr, object.data->addr + object.data->length());
+  }
+  if (object.bss) {
+    split(SectionType::BSS, object.bss->addr, object.bss->addr + object.bss->memoryLength());
+  }
+}
+
+// Whether execution can continue past the end of code chunk
+static bool fallsThrough(const u8* code, const Chunk& chunk) {
   using namespace abi;
 
-  if (labelAddress - mentionAddress < 0) {
-    // NRO
-    if (argumentNumber == 1) {
-      auto mode2 = extractModeArg2(code[mentionAddress - 2]);
-      code[mentionAddress - 2] = encodeFlags(NRO, mode2);
-    } else if (argumentNumber == 2) {
-      auto mode1 = extractModeArg1(code[mentionAddress - 6]);
-      code[mentionAddress - 6] = encodeFlags(mode1, NRO);
+  u32 offset = chunk.begin, last = chunk.begin;
+  while (offset < chunk.end) {
+    last = offset;
+    offset += instructionSize(code, offset);
+  }
+
+  // Chunk doesn't end on instruction boundary (raw bytes in code?)
+  if (offset != chunk.end || chunk.begin == chunk.end) {
+    return true;
+  }
+
+  switch ((OpCode) code[last+1]) {
+    case JUMP:
+    case TAILCALL:
+    case RET:
+    case HALT:
+      return false;
+    default:
+      return true;
+  }
+}
+
+static void collectRuns(const ObjectChunks& layout, size_t object, std::vector<Run>& runs) {
+  for (size_t c = 0; c < layout.chunks.size() && layout.chunks[c].type == SectionType::CODE; c++) {
+    if (c == 0 || !layout.chunks[c-1].fallsThrough) {
+      runs.push_back({object, c, c, 0});
     }
-  } else {
-    // PRO
-    if (argumentNumber == 1) {
-      auto mode2 = extractModeArg2(code[mentionAddress - 2]);
-      code[mentionAddress - 2] = encodeFlags(PRO, mode2);
-    } else if (argumentNumber == 2) {
-      auto mode1 = extractModeArg1(code[mentionAddress - 6]);
-      code[mentionAddress - 6] = encodeFlags(mode1, PRO);
+    runs.back().last = c;
+    runs.back().heat = std::max(runs.back().heat, layout.chunks[c].heat);
+  }
+}
+
+static int sectionKind(const SymbolTable::Symbol& symbol) {
+  return symbol.isData() ? 1 : symbol.isBss() ? 2 : 0;
+}
+
+// Length of chunk's body without the final ret, -1 if it can't be inlined
+static int inlineLength(const u8* code, const Chunk& chunk, const std::vector<i32>& mentions, u32 limit) {
+  using namespace abi;
+
+  auto mention = std::lower_bound(mentions.begin(), mentions.end(), (i32) chunk.begin);
+  if (chunk.type != SectionType::CODE || (mention != mentions.end() && *mention < (i32) chunk.end)) {
+    return -1;
+  }
+
+  int frames = 0;
+  u32 offset = chunk.begin;
+  while (offset < chunk.end) {
+    AddressingMode mode1 = extractModeArg1(code[offset]), mode2 = extractModeArg2(code[offset]);
+    if (mode1 == PRO || mode1 == NRO || mode2 == PRO || mode2 == NRO) {
+      return -1;
+    }
+
+    u32 size = instructionSize(code, offset);
+    switch ((OpCode) code[offset+1]) {
+      case CALL:
+      case TAILCALL:
+      case JUMP:
+      case JUMPT:
+      case JUMPF:
+      case RESET:
+        return -1;
+      case ENTER:
+        frames++;
+        break;
+      case LEAVE:
+        frames--;
+        break;
+      case RET:
+        if (offset + size != chunk.end || frames != 0 || offset - chunk.begin > limit) {
+          return -1;
+        }
+        return offset - chunk.begin;
+      default:
+        break;
     }
+    offset += size;
   }
+
+  return -1;
 }
 
-xvm::Executable xvm::link(const std::vector<Executable>& objects) {
-  xvm::Executable result;
+static std::vector<Executable> rearrangeObjects(const std::vector<Executable>& objects, bool gc, const Profiler::Profile& profile, std::vector<u32>& hashes) {
+  u32 inlineLimit = config::asInt("link-inline");
+  size_t threads = config::asInt("link-threads");
+  std::vector<ObjectChunks> layouts(objects.size());
+
+  parallelFor(objects.size(), [&](size_t i) {
+    auto& layout = layouts[i];
+    const auto& object = objects[i];
+
+    layout.code = &object.getSection("code");
+    layout.data = object.hasSection("data") ? &object.getSection("data") : nullptr;
+    layout.bss = object.hasSection("bss") ? &object.getSection("bss") : nullptr;
+    layout.symbols = SymbolTable::fromSection(object.getSection("symbols"));
+    layout.symbols.reindex();
+    layout.relocations = RelocationTable::fromSection(object.getSection("relocations"));
+    if (object.hasSection("objects")) {
+      layout.inputs = ObjectTable::fromSection(object.getSection("objects"));
+    }
 
-  u32 globalCodeOffset = 0;
-  std::vector<u32> codeSectionOffsets;
+    splitChunks(layout);
 
-  std::vector<u8> code;
+    if (inlineLimit > 0) {
+      std::vector<i32> mentions;
+      for (const auto& relocation : layout.relocations.relocations) {
+        for (const auto& mention : relocation.mentions) {
+          mentions.push_back(mention.address);
+        }
+      }
+      std::sort(mentions.begin(), mentions.end());
+
+      for (auto& chunk : layout.chunks) {
+        chunk.inlineLength = inlineLength(layout.code->bytes(), chunk, mentions, inlineLimit);
+      }
+    }
+
+    for (const auto& symbol : layout.symbols.symbols) {
+      int chunk = layout.find(symbol.address);
+      if (symbol.isExtern() || symbol.isData() || symbol.isBss() || chunk == -1) {
+        continue;
+      }
 
-  SymbolTable symbolTable, resultSymbolTable;
-  RelocationTable relocationTable, resultRelocationTable;
+      // LOCAL labels of the same name in other objects must not add up, they
+      // only match with the object they came from
+      u64 count = 0;
+      auto own = profile.byObject.find({hashes[i], symbol.label});
+      if (own != profile.byObject.end()) {
+        count = own->second;
+      } else if (!symbol.isLocal()) {
+        auto global = profile.byLabel.find(symbol.label);
+        count = global != profile.byLabel.end() ? global->second : 0;
+      }
 
-  for (auto& object : objects) {
-    codeSectionOffsets.push_back(globalCodeOffset);
-    auto codeSection = object.getSection("code");
-    for (auto byte : codeSection.data) {
-      code.push_back(byte);
+      layout.chunks[chunk].heat = std::max(layout.chunks[chunk].heat, count);
     }
-    globalCodeOffset += codeSection.data.size();
+  }, threads);
+
+  size_t chunkCount = 0;
+  for (auto& layout : layouts) {
+    layout.firstChunk = chunkCount;
+    chunkCount += layout.chunks.size();
   }
-  for (int i = 0; i < objects.size(); i++) {
-    if (!objects[i].hasSection("symbols")) {
-      fatal("No 'symbols' section present in object file, can't link");
-      die();
+
+  struct Definition {
+    size_t object;
+    const SymbolTable::Symbol* symbol;
+  };
+
+  std::unordered_map<std::string, Definition> globals;
+  for (size_t i = 0; i < layouts.size(); i++) {
+    for (const auto& symbol : layouts[i].symbols.symbols) {
+      if (!symbol.isExtern() && !symbol.isLocal()) {
+        globals.emplace(symbol.label, Definition{i, &symbol});
+      }
+    }
+  }
+
+  // Exports are kept as roots then
+  bool keepExports = config::asBool("link-shared");
+  for (const auto& layout : layouts) {
+    for (const auto& symbol : layout.symbols.symbols) {
+      if (symbol.isExtern() && globals.find(symbol.label) == globals.end()) {
+        keepExports = true;
+      }
     }
+  }
+
+  // Edges are found per object, chunk ids are global
+  std::vector<std::vector<std::vector<size_t>>> edges(layouts.size());
+
+  parallelFor(layouts.size(), [&](size_t i) {
+    auto& layout = layouts[i];
+    auto& objectEdges = edges[i];
+    const u8* code = layout.code->bytes();
+    objectEdges.resize(layout.chunks.size());
+
+    auto addEdge = [&](u32 mention, size_t object, u32 address) {
+      int from = layout.find(mention), to = layouts[object].find(address);
+      if (from != -1 && to != -1) {
+        objectEdges[from].push_back(layouts[object].firstChunk + to);
+      }
+    };
 
-    auto objectSymbolTable = SymbolTable::fromSection(objects[i].getSection("symbols"));
+    // Call to start of inlinable chunk
+    auto tryInline = [&](const RelocationTable::RelocationEntry::SymbolMention& mention, size_t object, u32 address) {
+      u8 flags = code[mention.address-2], opcode = code[mention.address-1];
+      int chunk = layouts[object].find(address);
 
-    for (const auto& symbol : objectSymbolTable.symbols) {
-      symbolTable.addSymbol(symbol.address + codeSectionOffsets[i], symbol.label, symbol.flags, symbol.size);
+      if (mention.argumentNumber != 1 || (opcode != abi::CALL && opcode != abi::TAILCALL)
+          || abi::extractModeArg1(flags) == abi::STK || abi::extractModeArg2(flags) != abi::_NONE
+          || chunk == -1 || layouts[object].chunks[chunk].begin != address
+          || layouts[object].chunks[chunk].inlineLength < 0) {
+        return false;
+      }
+
+      layout.inlines.push_back({(u32) mention.address-2, (u32) object, (u32) chunk, opcode == abi::TAILCALL});
+      layout.inlinedMentions.insert(mention.address);
+      return true;
+    };
+
+    for (const auto& relocation : layout.relocations.relocations) {
+      const SymbolTable::Symbol* own = layout.symbols.findByLabel(relocation.label);
+
+      for (const auto& mention : relocation.mentions) {
+        i32 target = abi::decodeAddress(code, mention.address, mention.argumentNumber);
+
+        if (inlineLimit > 0) {
+          bool inlined = false;
+          if (own && !own->isExtern()) {
+            inlined = target == own->address && tryInline(mention, i, target);
+          } else {
+            auto global = globals.find(relocation.label);
+            inlined = global != globals.end() && target == 0
+              && tryInline(mention, global->second.object, global->second.symbol->address);
+          }
+          if (inlined) {
+            continue;
+          }
+        }
+
+        if (own && !own->isExtern()) {
+          addEdge(mention.address, i, own->address);
+          addEdge(mention.address, i, target);
+        } else {
+          auto global = globals.find(relocation.label);
+          if (global != globals.end()) {
+            const auto& definition = global->second;
+            addEdge(mention.address, definition.object, definition.symbol->address);
+            addEdge(mention.address, definition.object, definition.symbol->address + target);
+          }
+        }
+      }
+    }
+
+    for (size_t c = 0; c + 1 < layout.chunks.size(); c++) {
+      auto& chunk = layout.chunks[c];
+      if (chunk.type == SectionType::CODE && layout.chunks[c+1].type == SectionType::CODE && fallsThrough(code, chunk)) {
+        chunk.fallsThrough = true;
+        objectEdges[c].push_back(layout.firstChunk + c + 1);
+      }
+    }
+
+    std::sort(layout.inlines.begin(), layout.inlines.end(),
+      [](const Inline& lhs, const Inline& rhs) { return lhs.site < rhs.site; });
+  }, threads);
+
+  // Global chunk id -> (object, chunk)
+  std::vector<std::pair<u32, u32>> chunkIds;
+  chunkIds.reserve(chunkCount);
+  for (size_t i = 0; i < layouts.size(); i++) {
+    for (size_t c = 0; c < layouts[i].chunks.size(); c++) {
+      chunkIds.push_back({i, c});
     }
   }
 
-  for (int i = 0; i < objects.size(); i++) {
-    if (!objects[i].hasSection("relocations")) {
-      fatal("No 'relocations' section present in object file, can't link");
-      die();
+  std::vector<size_t> worklist;
+  auto markLive = [&](size_t id) {
+    auto& chunk = layouts[chunkIds[id].first].chunks[chunkIds[id].second];
+    if (!chunk.live) {
+      chunk.live = true;
+      worklist.push_back(id);
+    }
+  };
+
+  auto markSymbol = [&](size_t object, const SymbolTable::Symbol& symbol) {
+    int chunk = layouts[object].find(symbol.address);
+    if (chunk != -1) {
+      markLive(layouts[object].firstChunk + chunk);
+    }
+  };
+
+  if (!layouts.empty() && !layouts[0].chunks.empty()) {
+    markLive(0);
+  }
+
+  for (size_t i = 0; i < layouts.size(); i++) {
+    for (const auto& symbol : layouts[i].symbols.symbols) {
+      if (symbol.isExtern()) {
+        continue;
+      }
+      if ((symbol.flags & (u16) SymbolFlags::ENTRY) || (keepExports && !symbol.isLocal())) {
+        markSymbol(i, symbol);
+      }
+    }
+  }
+
+  if (!gc) {
+    for (size_t id = 0; id < chunkCount; id++) {
+      markLive(id);
+    }
+  }
+
+  while (!worklist.empty()) {
+    size_t id = worklist.back();
+    worklist.pop_back();
+    for (size_t to : edges[chunkIds[id].first][chunkIds[id].second]) {
+      markLive(to);
+    }
+  }
+
+  // Code is packed per object here, unless a profile lays it out across objects below
+  bool global = !profile.empty();
+  std::vector<std::vector<u8>> codes(layouts.size()), datas(layouts.size());
+  std::vector<u32> bssSizes(layouts.size(), 0);
+  std::vector<u32> removed(layouts.size(), 0);
+
+  auto packCode = [&layouts](ObjectChunks& layout, Chunk& chunk, std::vector<u8>& code) {
+    const u8* objectCode = layout.code->bytes();
+    chunk.newBegin = code.size();
+
+    auto site = std::lower_bound(layout.inlines.begin(), layout.inlines.end(), chunk.begin,
+      [](const Inline& inlined, u32 address) { return inlined.site < address; });
+    u32 from = chunk.begin;
+    i32 added = 0;
+
+    for (; site != layout.inlines.end() && site->site < chunk.end; site++) {
+      const auto& callee = layouts[site->object];
+      const auto& body = callee.chunks[site->chunk];
+      u32 length = site->isTail ? body.end - body.begin : body.inlineLength;
+      u32 callSize = abi::instructionSize(objectCode, site->site);
+
+      code.insert(code.end(), objectCode + from, objectCode + site->site);
+      code.insert(code.end(), callee.code->bytes() + body.begin, callee.code->bytes() + body.begin + length);
+
+      added += (i32) length - (i32) callSize;
+      chunk.growth.push_back({site->site, added});
+      from = site->site + callSize;
+    }
+
+    code.insert(code.end(), objectCode + from, objectCode + chunk.end);
+  };
+
+  parallelFor(layouts.size(), [&](size_t i) {
+    auto& layout = layouts[i];
+    const u8* objectData = layout.data ? layout.data->bytes() : nullptr;
+
+    for (auto& chunk : layout.chunks) {
+      if (!chunk.live) {
+        removed[i] += chunk.type == SectionType::BSS ? 0 : chunk.end - chunk.begin;
+        continue;
+      }
+
+      if (chunk.type == SectionType::CODE) {
+        if (!global) {
+          packCode(layout, chunk, codes[i]);
+        }
+      } else if (chunk.type == SectionType::DATA) {
+        chunk.newBegin = datas[i].size();
+        const u8* bytes = objectData + (chunk.begin - layout.data->addr);
+        datas[i].insert(datas[i].end(), bytes, bytes + (chunk.end - chunk.begin));
+      } else {
+        chunk.newBegin = bssSizes[i];
+        bssSizes[i] += chunk.end - chunk.begin;
+      }
+    }
+  }, threads);
+
+  // Where data and bss of every object start in its output
+  std::vector<u32> dataAddrs(layouts.size()), bssAddrs(layouts.size());
+  std::vector<u8> mergedCode, mergedData;
+  u32 mergedDataAddr = 0, mergedBssAddr = 0, mergedBssSize = 0;
+  ObjectTable objectTable;
+
+  if (global) {
+    std::vector<Run> runs;
+    for (size_t i = 0; i < layouts.size(); i++) {
+      collectRuns(layouts[i], i, runs);
+    }
+
+    // Entry run stays first, never executed runs keep their order at the end
+    auto begin = runs.begin() + (runs.empty() ? 0 : 1);
+    std::stable_sort(begin, runs.end(), [](const Run& lhs, const Run& rhs) { return lhs.heat > rhs.heat; });
+
+    for (const auto& run : runs) {
+      auto& layout = layouts[run.object];
+      for (size_t c = run.first; c <= run.last; c++) {
+        auto& chunk = layout.chunks[c];
+        if (!chunk.live) {
+          continue;
+        }
+
+        u32 hash = layout.inputs.objects.empty() ? hashes[run.object] : layout.inputs.findHash(chunk.begin);
+        if (objectTable.objects.empty() || objectTable.objects.back().hash != hash) {
+          objectTable.objects.push_back({(u32) mergedCode.size(), hash});
+        }
+        packCode(layout, chunk, mergedCode);
+      }
+    }
+
+    // Objects keep their data apart, aligned the way linking them separately would
+    mergedDataAddr = alignUp(mergedCode.size(), XVM_SECTION_MEMORY_ALIGN);
+    for (size_t i = 0; i < layouts.size(); i++) {
+      mergedData.resize(alignUp(mergedData.size(), XVM_SECTION_MEMORY_ALIGN), 0);
+      dataAddrs[i] = mergedDataAddr + mergedData.size();
+      mergedData.insert(mergedData.end(), datas[i].begin(), datas[i].end());
+    }
+
+    mergedBssAddr = alignUp(mergedDataAddr + mergedData.size(), XVM_SECTION_MEMORY_ALIGN);
+    for (size_t i = 0; i < layouts.size(); i++) {
+      mergedBssSize = alignUp(mergedBssSize, XVM_SECTION_MEMORY_ALIGN);
+      bssAddrs[i] = mergedBssAddr + mergedBssSize;
+      mergedBssSize += bssSizes[i];
+    }
+  } else {
+    // Same layout as assembler produces
+    for (size_t i = 0; i < layouts.size(); i++) {
+      dataAddrs[i] = alignUp(codes[i].size(), XVM_SECTION_MEMORY_ALIGN);
+      bssAddrs[i] = alignUp(dataAddrs[i] + datas[i].size(), XVM_SECTION_MEMORY_ALIGN);
+    }
+  }
+
+  std::vector<SymbolTable> symbolTables(layouts.size());
+  std::vector<RelocationTable> relocationTables(layouts.size());
+  std::vector<std::vector<int>> relocationKinds(layouts.size()); // Section kind of the definition, -1 if unresolved
+
+  for (size_t i = 0; i < layouts.size(); i++) {
+    for (auto& chunk : layouts[i].chunks) {
+      chunk.newBegin += chunk.type == SectionType::DATA ? dataAddrs[i] : chunk.type == SectionType::BSS ? bssAddrs[i] : 0;
+    }
+  }
+
+  parallelFor(layouts.size(), [&](size_t i) {
+    auto& layout = layouts[i];
+    const u8* objectCode = layout.code->bytes();
+    std::vector<u8>& code = global ? mergedCode : codes[i];
+
+    for (const auto& relocation : layout.relocations.relocations) {
+      // Mentions of other objects' definitions are only resolved here when objects get merged
+      const SymbolTable::Symbol* definition = layout.symbols.findByLabel(relocation.label);
+      const ObjectChunks* definer = &layout;
+      bool isOwn = definition && !definition->isExtern();
+      if (!isOwn) {
+        auto itr = global ? globals.find(relocation.label) : globals.end();
+        definition = itr != globals.end() ? itr->second.symbol : nullptr;
+        definer = itr != globals.end() ? &layouts[itr->second.object] : nullptr;
+      }
+
+      RelocationTable::RelocationEntry entry = {relocation.label, {}};
+
+      for (const auto& mention : relocation.mentions) {
+        if (layout.inlinedMentions.count(mention.address)) {
+          continue;
+        }
+
+        int chunk = layout.find(mention.address);
+        if (chunk == -1 || !layout.chunks[chunk].live) {
+          continue;
+        }
+
+        u32 address = layout.remap(mention.address);
+        if (definition) {
+          // Target can lie outside of any chunk with an addend, keep its distance to the symbol then
+          i32 target = abi::decodeAddress(objectCode, mention.address, mention.argumentNumber);
+          if (!isOwn) {
+            target += definition->address;
+          }
+          i32 moved = definer->find(target) != -1
+            ? definer->remap(target)
+            : definer->remap(definition->address) + (target - definition->address);
+          abi::encodeAddress(code.data(), moved, address, mention.argumentNumber, false);
+        }
+        entry.mentions.push_back({(i32) address, mention.argumentNumber});
+      }
+
+      if (!entry.mentions.empty()) {
+        relocationTables[i].relocations.push_back(std::move(entry));
+        relocationKinds[i].push_back(definition ? sectionKind(*definition) : -1);
+      }
+    }
+
+    // Externs are dropped along with their last unresolved mention
+    std::unordered_set<std::string> mentioned;
+    for (size_t e = 0; e < relocationTables[i].relocations.size(); e++) {
+      if (relocationKinds[i][e] == -1) {
+        mentioned.insert(relocationTables[i].relocations[e].label);
+      }
+    }
+
+    auto& symbols = symbolTables[i];
+    for (const auto& symbol : layout.symbols.symbols) {
+      if (symbol.isExtern()) {
+        if (mentioned.count(symbol.label)) {
+          symbols.addSymbol(symbol.address, symbol.label, symbol.flags, symbol.size);
+        }
+        continue;
+      }
+
+      int chunk = layout.find(symbol.address);
+      if (chunk != -1 && layout.chunks[chunk].live) {
+        symbols.addSymbol(layout.remap(symbol.address), symbol.label, symbol.flags, symbol.size);
+      }
+    }
+  }, threads);
+
+  u32 total = 0;
+  for (u32 bytes : removed) {
+    total += bytes;
+  }
+  if (gc) {
+    debug("Garbage collection removed %u bytes of code and data", total);
+  }
+
+  if (inlineLimit > 0) {
+    size_t inlined = 0;
+    for (const auto& layout : layouts) {
+      for (const auto& site : layout.inlines) {
+        inlined += layout.chunks[layout.find(site.site)].live;
+      }
     }
+    debug("Inlined %zu calls", inlined);
+  }
+
+  if (!global) {
+    std::vector<Executable> result(layouts.size());
+    for (size_t i = 0; i < layouts.size(); i++) {
+      auto& object = result[i];
+      object.magic = XVM_MAGIC;
+      object.version = objects[i].version;
+      object.flags = 0;
+
+      object.sections.push_back(Executable::Section(SectionType::CODE, "code", codes[i], 0));
+
+      if (layouts[i].data) {
+        object.sections.push_back(Executable::Section(SectionType::DATA, "data", datas[i], dataAddrs[i]));
+      }
+
+      if (layouts[i].bss) {
+        object.sections.push_back(Executable::Section(SectionType::BSS, "bss", {}, bssAddrs[i]));
+        object.sections.back().rawSize = bssSizes[i];
+      }
+
+      object.sections.push_back(symbolTables[i].toSection());
+      object.sections.push_back(relocationTables[i].toSection());
+    }
+    return result;
+  }
 
-    auto objectRelocationTable = RelocationTable::fromSection(objects[i].getSection("relocations"));
-  
-    for (auto relocation : objectRelocationTable.relocations) {
-      for (auto& mention : relocation.mentions) {
-        mention.address += codeSectionOffsets[i];
+  // Unresolved externs come first, so a LOCAL definition of the same label
+  // in another object doesn't take over their mentions when linked
+  SymbolTable symbols;
+  std::unordered_set<std::string> externs;
+  for (const auto& table : symbolTables) {
+    for (const auto& symbol : table.symbols) {
+      if (symbol.isExtern() && externs.insert(symbol.label).second) {
+        symbols.addSymbol(symbol.address, symbol.label, symbol.flags, symbol.size);
       }
-      relocationTable.relocations.push_back(relocation);
+    }
+  }
+  for (const auto& table : symbolTables) {
+    for (const auto& symbol : table.symbols) {
+      if (!symbol.isExtern()) {
+        symbols.addSymbol(symbol.address, symbol.label, symbol.flags, symbol.size);
+      }
+    }
+  }
+
+  // Mentions are already moved, link only needs a definition in the same
+  // section to relocate them. Labels can be defined by several objects now,
+  // mentions of a label found elsewhere first go by a label of that section
+  std::string anchors[3];
+  for (const auto& symbol : symbols.symbols) {
+    if (!symbol.isExtern() && anchors[sectionKind(symbol)].empty() && symbols.findByLabel(symbol.label) == &symbol) {
+      anchors[sectionKind(symbol)] = symbol.label;
     }
   }
 
-  for (const auto& symbol : symbolTable.symbols) {
-    bool hasNonExternCounterpart = std::find_if(
-      symbolTable.symbols.begin(),
-      symbolTable.symbols.end(),
-      [&symbol](const auto& symbol2) {
-        return !symbol2.isExtern() && symbol2.label == symbol.label;
+  RelocationTable relocations;
+  for (size_t i = 0; i < relocationTables.size(); i++) {
+    for (size_t e = 0; e < relocationTables[i].relocations.size(); e++) {
+      auto& entry = relocationTables[i].relocations[e];
+      int kind = relocationKinds[i][e];
+      const auto* found = symbols.findByLabel(entry.label);
+
+      if (kind != -1 && (found->isExtern() || sectionKind(*found) != kind)) {
+        if (anchors[kind].empty()) {
+          fatal("No unique label left to relocate mentions of '%s' with", entry.label.c_str());
+          die();
+        }
+        entry.label = anchors[kind];
       }
-    ) != symbolTable.symbols.end();
+      relocations.relocations.push_back(std::move(entry));
+    }
+  }
+
+  Executable merged;
+  merged.magic = XVM_MAGIC;
+  merged.version = objects.empty() ? XVM_VERSION_CODE : objects[0].version;
+  merged.flags = 0;
+
+  merged.sections.push_back(Executable::Section(SectionType::CODE, "code", mergedCode, 0));
 
-    if (symbol.isExtern() && hasNonExternCounterpart) {
+  bool hasData = false, hasBss = false;
+  for (const auto& layout : layouts) {
+    hasData = hasData || layout.data;
+    hasBss = hasBss || layout.bss;
+  }
+
+  if (hasData) {
+    merged.sections.push_back(Executable::Section(SectionType::DATA, "data", mergedData, mergedDataAddr));
+  }
+
+  if (hasBss) {
+    merged.sections.push_back(Executable::Section(SectionType::BSS, "bss", {}, mergedBssAddr));
+    merged.sections.back().rawSize = mergedBssSize;
+  }
+
+  merged.sections.push_back(symbols.toSection());
+  merged.sections.push_back(relocations.toSection());
+  merged.sections.push_back(objectTable.toSection());
+
+  // Objects section of merged object identifies input objects from now on
+  hashes = {hashes.empty() ? 0 : hashes[0]};
+  std::vector<Executable> result;
+  result.push_back(std::move(merged));
+  return result;
+}
+
+/*
+Externs that no object defines, but a library from dynamic-libs exports, are
+imported from it. Every import gets a stub appended to code (see
+DynamicLinker), the libraries used are listed in runinfo section. Only code
+can be imported, data of a library isn't reachable from another image
+*/
+static RunInfo findImports(const std::vector<std::string>& externs) {
+  RunInfo runInfo;
+  std::unordered_set<std::string> imported;
+  bool hadErrors = false;
+
+  for (const auto& filename : splitString(config::get("dynamic-libs"), ',')) {
+    if (filename.empty()) {
       continue;
     }
 
-    resultSymbolTable.symbols.push_back(symbol);
+    Executable library = Executable::fromFile(filename);
+    if (library.magic != XVM_MAGIC || !library.hasSection("symbols")) {
+      fatal("'%s' is not a dynamic library", filename.c_str());
+      die();
+    }
+
+    if (!(library.flags & (u32) ExecutableFlags::PIC)) {
+      fatal("'%s' isn't position independent, link it with pic set", filename.c_str());
+      die();
+    }
+
+    auto table = SymbolTable::fromSection(library.getSection("symbols"));
+    bool used = false;
+
+    for (const auto& label : externs) {
+      const auto* symbol = table.findByLabel(label);
+      if (!symbol || symbol->isExtern() || symbol->isLocal() || imported.count(label)) {
+        continue;
+      }
+
+      if (symbol->isData() || symbol->isBss()) {
+        error("'%s' from '%s' is data, it can't be imported", label.c_str(), filename.c_str());
+        hadErrors = true;
+        continue;
+      }
+
+      debug("Importing '%s' from '%s'", label.c_str(), filename.c_str());
+      imported.insert(label);
+      runInfo.imports.push_back({0, label});
+      used = true;
+    }
+
+    if (used) {
+      runInfo.libraries.push_back(filename);
+    }
   }
 
-  for (const auto& relocation : relocationTable.relocations) {
-    if (resultSymbolTable.hasLabel(relocation.label)) {
-      const auto& symbol = resultSymbolTable.getByLabel(relocation.label);
+  if (hadErrors) {
+    fatal("Linking failed");
+    die();
+  }
+
+  return runInfo;
+}
+
+/*
+Output layout is [code of every object][import stubs][data of every object][bss of every object].
+Objects carry all their symbols (LOCAL ones are only visible inside the
+object) and relocations for all label mentions, so every mention is
+repatched for the new layout: addend is recovered from the argument as
+assembled, then the argument is encoded again against the new address.
+
+Decoding objects, copying their sections and patching run per object on
+a thread pool. Offsets and symbol order are computed serially in object
+order, so the output doesn't depend on scheduling.
+*/
+// Fills cache when given, leaving room after every object for it to grow
+// hashes identify input objects (LinkCache::objectHash), objects can be rearranged copies
+static xvm::Executable linkObjects(const std::vector<Executable>& objects, const std::vector<u32>& hashes, LinkCache* cache = nullptr) {
+  xvm::Executable result;
+
+  struct Patch {
+    i32 address; // In output
+    u8 argumentNumber;
+    i32 target;
+  };
+
+  struct ObjectLayout {
+    const Executable::Section* code = nullptr;
+    const Executable::Section* data = nullptr;
+    const Executable::Section* bss = nullptr;
+    u32 codeOffset = 0;
+    u32 dataOffset = 0; // From output data start
+    u32 bssOffset = 0;  // From output bss start
+    SymbolTable symbols;
+    RelocationTable relocations;
+    RelocationTable unresolved;
+    std::vector<LinkCache::Import> imports;
+  };
+
+  // Libraries are mapped far away from address 0, absolute addresses would point into the program
+  if (config::asBool("link-shared") && !config::asBool("pic")) {
+    fatal("link-shared needs pic set");
+    die();
+  }
+
+  size_t threads = config::asInt("link-threads");
+  std::vector<ObjectLayout> layouts(objects.size());
+
+  parallelFor(objects.size(), [&](size_t i) {
+    auto& layout = layouts[i];
+    const auto& object = objects[i];
+
+    layout.code = &object.getSection("code");
+    layout.data = object.hasSection("data") ? &object.getSection("data") : nullptr;
+    layout.bss = object.hasSection("bss") ? &object.getSection("bss") : nullptr;
+
+    layout.symbols = SymbolTable::fromSection(object.getSection("symbols"));
+    layout.symbols.reindex();
+    layout.relocations = RelocationTable::fromSection(object.getSection("relocations"));
+  }, threads);
+
+  RunInfo runInfo;
+  if (!config::get("dynamic-libs").empty()) {
+    std::unordered_set<std::string> defined, seen;
+    std::vector<std::string> externs;
+    for (const auto& layout : layouts) {
+      for (const auto& symbol : layout.symbols.symbols) {
+        if (!symbol.isExtern() && !symbol.isLocal()) {
+          defined.insert(symbol.label);
+        }
+      }
+    }
+    for (const auto& layout : layouts) {
+      for (const auto& symbol : layout.symbols.symbols) {
+        if (symbol.isExtern() && !defined.count(symbol.label) && seen.insert(symbol.label).second) {
+          externs.push_back(symbol.label);
+        }
+      }
+    }
+    runInfo = findImports(externs);
+  }
+
+  u32 codeSize = 0, dataSize = 0, bssSize = 0;
+
+  auto slot = [cache](u32 size) -> u32 {
+    return cache ? size + XVM_LINKCACHE_SLACK(size) : size;
+  };
+
+  if (cache) {
+    cache->objects.resize(objects.size());
+  }
+
+  for (size_t i = 0; i < layouts.size(); i++) {
+    auto& layout = layouts[i];
+    layout.codeOffset = codeSize;
+    codeSize += slot(layout.code->length());
+
+    if (layout.data) {
+      dataSize = alignUp(dataSize, XVM_SECTION_MEMORY_ALIGN);
+      layout.dataOffset = dataSize;
+      dataSize += slot(layout.data->length());
+    }
+
+    if (layout.bss) {
+      bssSize = alignUp(bssSize, XVM_SECTION_MEMORY_ALIGN);
+      layout.bssOffset = bssSize;
+      bssSize += slot(layout.bss->memoryLength());
+    }
+
+    if (cache) {
+      auto& entry = cache->objects[i];
+      entry.hash = hashes[i];
+      entry.codeOffset = layout.codeOffset;
+      entry.codeSlot = codeSize - layout.codeOffset;
+      entry.dataOffset = layout.dataOffset;
+      entry.dataSlot = layout.data ? dataSize - layout.dataOffset : 0;
+      entry.bssOffset = layout.bssOffset;
+      entry.bssSlot = layout.bss ? bssSize - layout.bssOffset : 0;
+    }
+  }
+
+  u32 stubsBase = codeSize;
+  codeSize += runInfo.imports.size() * XVM_DYNAMIC_STUB_SIZE;
+  for (u32 i = 0; i < runInfo.imports.size(); i++) {
+    runInfo.imports[i].stub = stubsBase + i * XVM_DYNAMIC_STUB_SIZE;
+  }
+
+  std::vector<u8> code(codeSize);
+  std::vector<u8> data(dataSize, 0);
+
+  parallelFor(layouts.size(), [&](size_t i) {
+    auto& layout = layouts[i];
+    std::copy_n(layout.code->bytes(), layout.code->length(), code.begin() + layout.codeOffset);
+    if (layout.data) {
+      std::copy_n(layout.data->bytes(), layout.data->length(), data.begin() + layout.dataOffset);
+    }
+  }, threads);
+
+  u32 dataBase = alignUp(code.size(), XVM_SECTION_MEMORY_ALIGN);
+  u32 bssBase = alignUp(dataBase + data.size(), XVM_SECTION_MEMORY_ALIGN);
+
+  auto relocate = [&](const ObjectLayout& layout, const SymbolTable::Symbol& symbol) -> i32 {
+    if (symbol.isData()) {
+      return dataBase + layout.dataOffset + (symbol.address - layout.data->addr);
+    } else if (symbol.isBss()) {
+      return bssBase + layout.bssOffset + (symbol.address - layout.bss->addr);
+    }
+    return layout.codeOffset + symbol.address;
+  };
+
+  SymbolTable resultSymbolTable;
+  RelocationTable resultRelocationTable;
+
+  // Label -> address of the exported definition
+  std::unordered_map<std::string, i32> globals;
+  bool hadDuplicates = false;
+
+  for (size_t i = 0; i < layouts.size(); i++) {
+    for (const auto& symbol : layouts[i].symbols.symbols) {
+      if (symbol.isExtern()) {
+        continue;
+      }
+
+      i32 address = relocate(layouts[i], symbol);
+      resultSymbolTable.addSymbol(address, symbol.label, symbol.flags, symbol.size);
+
+      if (symbol.isLocal()) {
+        continue;
+      }
+
+      if (!globals.emplace(symbol.label, address).second) {
+        error("Duplicate definition of symbol '%s'", symbol.label.c_str());
+        hadDuplicates = true;
+      } else if (cache) {
+        cache->globals[symbol.label] = {(u32) i, address};
+      }
+    }
+  }
+
+  if (hadDuplicates) {
+    fatal("Linking failed");
+    die();
+  }
+
+  for (u32 i = 0; i < runInfo.imports.size(); i++) {
+    const auto& import = runInfo.imports[i];
+    DynamicLinker::encodeStub(code.data() + import.stub, i);
+    globals.emplace(import.label, import.stub);
+    resultSymbolTable.addSymbol(import.stub, import.label, (u16) SymbolFlags::LABEL | (u16) SymbolFlags::LOCAL);
+  }
+
+  std::unordered_set<std::string> unresolved;
+  for (auto& layout : layouts) {
+    for (const auto& symbol : layout.symbols.symbols) {
+      if (symbol.isExtern() && globals.find(symbol.label) == globals.end() && unresolved.insert(symbol.label).second) {
+        resultSymbolTable.addSymbol(symbol.address, symbol.label, symbol.flags, symbol.size);
+      }
+    }
+  }
+
+  bool pic = config::asBool("pic");
+
+  // Objects only patch their own part of the output code
+  parallelFor(layouts.size(), [&](size_t i) {
+    auto& layout = layouts[i];
+    const u8* objectCode = layout.code->bytes();
+    std::vector<Patch> patches;
+
+    for (const auto& relocation : layout.relocations.relocations) {
+      // Object's own definition wins over a global one with the same name
+      const SymbolTable::Symbol* own = layout.symbols.findByLabel(relocation.label);
+      bool isOwn = own && !own->isExtern();
+      i32 target = 0;
+
+      if (isOwn) {
+        target = relocate(layout, *own);
+      } else {
+        auto global = globals.find(relocation.label);
+        if (global == globals.end()) {
+          RelocationTable::RelocationEntry entry = relocation;
+          for (auto& mention : entry.mentions) {
+            mention.address += layout.codeOffset;
+          }
+          layout.unresolved.relocations.push_back(entry);
+          continue;
+        }
+        target = global->second;
+      }
 
       for (const auto& mention : relocation.mentions) {
-        abi::N32 value;
-        if (config::asBool("pic")) {
-          patchAddressingMode(code.data(), symbol.address, mention.address, mention.argumentNumber);
-          value._i32 = std::abs(symbol.address - mention.address); // TODO: fix signed/unsiged mess
-        } else {
-          value._i32 = symbol.address;
+        i32 addend = abi::decodeAddress(objectCode, mention.address, mention.argumentNumber);
+        if (isOwn) {
+          addend -= own->address;
+        }
+        patches.push_back({(i32) (mention.address + layout.codeOffset), mention.argumentNumber, target + addend});
+
+        if (cache && !isOwn) {
+          layout.imports.push_back({(u32) i, (i32) (mention.address + layout.codeOffset), mention.argumentNumber, addend, relocation.label});
         }
-        code[mention.address]   = value._u8[0];
-        code[mention.address+1] = value._u8[1];
-        code[mention.address+2] = value._u8[2];
-        code[mention.address+3] = value._u8[3];
       }
-    } else {
-      resultRelocationTable.relocations.push_back(relocation);
+    }
+
+    std::sort(patches.begin(), patches.end(),
+      [](const Patch& lhs, const Patch& rhs) { return lhs.address < rhs.address; });
+
+    for (const auto& patch : patches) {
+      abi::encodeAddress(code.data(), patch.target, patch.address, patch.argumentNumber, pic);
+    }
+  }, threads);
+
+  if (cache) {
+    cache->codeSize = codeSize;
+    cache->dataSize = dataSize;
+    cache->bssSize = bssSize;
+    for (auto& layout : layouts) {
+      std::move(layout.imports.begin(), layout.imports.end(), std::back_inserter(cache->imports));
+    }
+  }
+
+  for (auto& layout : layouts) {
+    for (auto& entry : layout.unresolved.relocations) {
+      resultRelocationTable.relocations.push_back(std::move(entry));
     }
   }
 
   result.magic = XVM_MAGIC;
   result.version = XVM_VERSION_CODE;
-  result.flags = 0;
+  result.flags = pic ? (u32) ExecutableFlags::PIC : 0;
 
   result.sections.push_back(Executable::Section(
     SectionType::CODE,
@@ -131,8 +1108,465 @@ xvm::Executable xvm::link(const std::vector<Executable>& objects) {
     0
   ));
 
+  if (!data.empty()) {
+    result.sections.push_back(Executable::Section(
+      SectionType::DATA,
+      "data",
+      data,
+      dataBase
+    ));
+  }
+
+  if (bssSize > 0) {
+    result.sections.push_back(Executable::Section(
+      SectionType::BSS,
+      "bss",
+      {},
+      bssBase
+    ));
+    result.sections.back().rawSize = bssSize;
+  }
+
+  std::sort(resultSymbolTable.symbols.begin(), resultSymbolTable.symbols.end(),
+    [](auto& lhs, auto& rhs) { return lhs.address < rhs.address; });
+
   result.sections.push_back(resultSymbolTable.toSection());
   result.sections.push_back(resultRelocationTable.toSection());
 
+  // Objects merged by a profile guided layout already tell where code of their inputs went
+  ObjectTable objectTable;
+  for (size_t i = 0; i < layouts.size(); i++) {
+    if (!objects[i].hasSection("objects")) {
+      objectTable.objects.push_back({layouts[i].codeOffset, hashes[i]});
+      continue;
+    }
+    for (const auto& object : ObjectTable::fromSection(objects[i].getSection("objects")).objects) {
+      objectTable.objects.push_back({layouts[i].codeOffset + object.codeBegin, object.hash});
+    }
+  }
+  result.sections.push_back(objectTable.toSection());
+
+  if (!runInfo.imports.empty()) {
+    result.sections.push_back(runInfo.toSection());
+  }
+
   return result;
 }
+
+static std::vector<u32> objectHashes(const std::vector<Executable>& objects) {
+  std::vector<u32> hashes(objects.size());
+  parallelFor(objects.size(), [&](size_t i) {
+    hashes[i] = LinkCache::objectHash(objects[i]);
+  }, config::asInt("link-threads"));
+  return hashes;
+}
+
+static void checkObjects(const std::vector<Executable>& objects) {
+  for (const auto& object : objects) {
+    if (object.magic != XVM_MAGIC) {
+      fatal("Corrupted or unreadable object file, can't link");
+      die();
+    }
+
+    if (!object.hasSection("symbols")) {
+      fatal("No 'symbols' section present in object file, can't link");
+      die();
+    }
+
+    if (!object.hasSection("relocations")) {
+      fatal("No 'relocations' section present in object file, can't link");
+      die();
+    }
+  }
+}
+
+xvm::Executable xvm::link(const std::vector<Executable>& objects) {
+  checkObjects(objects);
+
+  bool gc = config::asBool("link-gc");
+  std::string profileFile = config::get("link-profile");
+
+  std::vector<u32> hashes = objectHashes(objects);
+
+  if (gc || !profileFile.empty() || config::asInt("link-inline") > 0) {
+    auto profile = profileFile.empty() ? Profiler::Profile() : Profiler::read(profileFile);
+    auto rearranged = rearrangeObjects(objects, gc, profile, hashes);
+    return linkObjects(rearranged, hashes);
+  }
+
+  return linkObjects(objects, hashes);
+}
+
+/*
+Archive members are only linked in when they define a symbol that is still
+unresolved, the same way it is done for static libraries on most systems.
+Members pulled in can reference externs of their own, so lookup is repeated
+until nothing new gets resolved. Objects are always linked before members,
+and members are appended in the order they were pulled, so output is stable.
+*/
+std::vector<xvm::Executable> xvm::resolveArchives(const std::vector<Executable>& objects, const std::vector<Archive>& archives) {
+  std::vector<Executable> selected(objects.begin(), objects.end());
+  std::unordered_set<std::string> defined;
+  std::vector<std::string> pending;
+  std::unordered_set<const Archive::Member*> pulled;
+
+  auto collect = [&defined, &pending](const Executable& object) {
+    if (!object.hasSection("symbols")) {
+      return;
+    }
+
+    auto table = SymbolTable::fromSection(object.getSection("symbols"));
+    for (const auto& symbol : table.symbols) {
+      if (symbol.isLocal()) {
+        continue;
+      }
+      if (symbol.isExtern()) {
+        pending.push_back(symbol.label);
+      } else {
+        defined.insert(symbol.label);
+      }
+    }
+  };
+
+  for (const auto& object : objects) {
+    collect(object);
+  }
+
+  for (size_t i = 0; i < pending.size(); i++) {
+    const auto& label = pending[i];
+    if (defined.count(label)) {
+      continue;
+    }
+
+    for (const auto& archive : archives) {
+      const auto* member = archive.findMember(label);
+      if (!member) {
+        continue;
+      }
+
+      if (pulled.insert(member).second) {
+        debug("Pulling '%s' for '%s'", member->name.c_str(), label.c_str());
+        selected.push_back(member->object);
+        collect(member->object);
+      }
+      break;
+    }
+  }
+
+  return selected;
+}
+
+xvm::Executable xvm::link(const std::vector<Executable>& objects, const std::vector<Archive>& archives) {
+  return link(resolveArchives(objects, archives));
+}
+
+static Executable::Section copySection(const Executable::Section& section) {
+  Executable::Section copy(section.type, section.label, std::vector<u8>(section.bytes(), section.bytes() + section.length()), section.addr);
+  if (section.type == SectionType::BSS) {
+    copy.rawSize = section.memoryLength();
+  }
+  return copy;
+}
+
+enum class PatchResult {
+  PATCHED,
+  UP_TO_DATE,
+  FAILED,
+};
+
+// Replaces changed objects in the previous output, see linkIncremental
+static PatchResult patchOutput(const std::vector<Executable>& objects, const std::string& filename, LinkCache& cache, Executable& result) {
+  if (cache.options != LinkCache::optionsHash() || cache.objects.size() != objects.size()) {
+    debug("Link options or object list changed");
+    return PatchResult::FAILED;
+  }
+
+  std::ifstream file(filename, std::ios::binary);
+  std::vector<u8> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (bytes.empty() || crc32c(bytes.data(), bytes.size()) != cache.outputHash) {
+    debug("Output is missing or was modified");
+    return PatchResult::FAILED;
+  }
+
+  std::vector<u32> hashes = objectHashes(objects);
+
+  std::vector<size_t> changed;
+  for (size_t i = 0; i < objects.size(); i++) {
+    if (hashes[i] != cache.objects[i].hash) {
+      changed.push_back(i);
+    }
+  }
+
+  if (changed.empty()) {
+    return PatchResult::UP_TO_DATE;
+  }
+
+  Executable previous = Executable::fromBuffer(bytes.data(), bytes.size());
+  if (previous.magic == XVM_BAD_MAGIC || !previous.hasSection("code") || !previous.hasSection("symbols")) {
+    return PatchResult::FAILED;
+  }
+
+  // Sizes are checked before copying, cache can be out of step with the output
+  const auto& previousCode = previous.getSection("code");
+  size_t previousDataSize = previous.hasSection("data") ? previous.getSection("data").length() : 0;
+  if (previousCode.length() != cache.codeSize || previousDataSize != cache.dataSize) {
+    return PatchResult::FAILED;
+  }
+
+  std::vector<u8> code(previousCode.bytes(), previousCode.bytes() + previousCode.length());
+  std::vector<u8> data;
+  if (previous.hasSection("data")) {
+    const auto& section = previous.getSection("data");
+    data.assign(section.bytes(), section.bytes() + section.length());
+  }
+
+  u32 dataBase = alignUp(cache.codeSize, XVM_SECTION_MEMORY_ALIGN);
+  u32 bssBase = alignUp(dataBase + cache.dataSize, XVM_SECTION_MEMORY_ALIGN);
+
+  struct Replacement {
+    size_t index;
+    const Executable::Section* code;
+    const Executable::Section* data;
+    const Executable::Section* bss;
+    SymbolTable symbols;
+    RelocationTable relocations;
+  };
+
+  std::vector<Replacement> replacements;
+  for (size_t i : changed) {
+    const auto& object = objects[i];
+    const auto& slot = cache.objects[i];
+    Replacement replacement = {
+      i,
+      &object.getSection("code"),
+      object.hasSection("data") ? &object.getSection("data") : nullptr,
+      object.hasSection("bss") ? &object.getSection("bss") : nullptr,
+      SymbolTable::fromSection(object.getSection("symbols")),
+      RelocationTable::fromSection(object.getSection("relocations"))
+    };
+
+    if (replacement.code->length() > slot.codeSlot
+        || (replacement.data && replacement.data->length() > slot.dataSlot)
+        || (replacement.bss && replacement.bss->memoryLength() > slot.bssSlot)) {
+      debug("Object %zu outgrew its place in output", i);
+      return PatchResult::FAILED;
+    }
+
+    // Exports can move, but not appear or disappear
+    size_t exports = 0;
+    for (const auto& symbol : replacement.symbols.symbols) {
+      if (symbol.isLocal() || symbol.isExtern()) {
+        continue;
+      }
+      auto global = cache.globals.find(symbol.label);
+      if (global == cache.globals.end() || global->second.object != i) {
+        debug("Object %zu exports '%s' now", i, symbol.label.c_str());
+        return PatchResult::FAILED;
+      }
+      exports++;
+    }
+
+    for (const auto& global : cache.globals) {
+      exports -= global.second.object == i;
+    }
+
+    if (exports != 0) {
+      debug("Object %zu doesn't export some of its symbols anymore", i);
+      return PatchResult::FAILED;
+    }
+
+    for (const auto& symbol : replacement.symbols.symbols) {
+      if (symbol.isExtern() && cache.globals.find(symbol.label) == cache.globals.end()) {
+        debug("Object %zu references unresolved '%s'", i, symbol.label.c_str());
+        return PatchResult::FAILED;
+      }
+    }
+
+    replacements.push_back(std::move(replacement));
+  }
+
+  auto relocate = [&](const Replacement& replacement, const SymbolTable::Symbol& symbol) -> i32 {
+    const auto& slot = cache.objects[replacement.index];
+    if (symbol.isData()) {
+      return dataBase + slot.dataOffset + (symbol.address - replacement.data->addr);
+    } else if (symbol.isBss()) {
+      return bssBase + slot.bssOffset + (symbol.address - replacement.bss->addr);
+    }
+    return slot.codeOffset + symbol.address;
+  };
+
+  std::unordered_set<size_t> replaced(changed.begin(), changed.end());
+  std::unordered_map<std::string, i32> moved; // Exports with new address
+  SymbolTable symbols;
+
+  auto inReplaced = [&](i32 address) {
+    for (size_t i : changed) {
+      const auto& slot = cache.objects[i];
+      if ((address >= (i32) slot.codeOffset && address < (i32) (slot.codeOffset + slot.codeSlot))
+          || (address >= (i32) (dataBase + slot.dataOffset) && address < (i32) (dataBase + slot.dataOffset + slot.dataSlot))
+          || (address >= (i32) (bssBase + slot.bssOffset) && address < (i32) (bssBase + slot.bssOffset + slot.bssSlot))) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  for (const auto& symbol : SymbolTable::fromSection(previous.getSection("symbols")).symbols) {
+    if (!inReplaced(symbol.address)) {
+      symbols.addSymbol(symbol.address, symbol.label, symbol.flags, symbol.size);
+    }
+  }
+
+  for (const auto& replacement : replacements) {
+    const auto& slot = cache.objects[replacement.index];
+
+    std::fill_n(code.begin() + slot.codeOffset, slot.codeSlot, 0);
+    std::copy_n(replacement.code->bytes(), replacement.code->length(), code.begin() + slot.codeOffset);
+
+    std::fill_n(data.begin() + slot.dataOffset, slot.dataSlot, 0);
+    if (replacement.data) {
+      std::copy_n(replacement.data->bytes(), replacement.data->length(), data.begin() + slot.dataOffset);
+    }
+
+    for (const auto& symbol : replacement.symbols.symbols) {
+      if (symbol.isExtern()) {
+        continue;
+      }
+
+      i32 address = relocate(replacement, symbol);
+      symbols.addSymbol(address, symbol.label, symbol.flags, symbol.size);
+
+      if (!symbol.isLocal() && cache.globals[symbol.label].address != address) {
+        cache.globals[symbol.label].address = address;
+        moved[symbol.label] = address;
+      }
+    }
+  }
+
+  bool pic = config::asBool("pic");
+
+  std::vector<LinkCache::Import> imports;
+  for (auto& import : cache.imports) {
+    if (replaced.count(import.object)) {
+      continue;
+    }
+
+    auto itr = moved.find(import.label);
+    if (itr != moved.end()) {
+      abi::encodeAddress(code.data(), itr->second + import.addend, import.address, import.argumentNumber, pic);
+    }
+    imports.push_back(std::move(import));
+  }
+
+  for (auto& replacement : replacements) {
+    const auto& slot = cache.objects[replacement.index];
+    const u8* objectCode = replacement.code->bytes();
+    replacement.symbols.reindex();
+
+    for (const auto& relocation : replacement.relocations.relocations) {
+      const SymbolTable::Symbol* own = replacement.symbols.findByLabel(relocation.label);
+      bool isOwn = own && !own->isExtern();
+      i32 target = isOwn ? relocate(replacement, *own) : cache.globals[relocation.label].address;
+
+      for (const auto& mention : relocation.mentions) {
+        i32 addend = abi::decodeAddress(objectCode, mention.address, mention.argumentNumber);
+        if (isOwn) {
+          addend -= own->address;
+        }
+
+        i32 address = slot.codeOffset + mention.address;
+        abi::encodeAddress(code.data(), target + addend, address, mention.argumentNumber, pic);
+
+        if (!isOwn) {
+          imports.push_back({(u32) replacement.index, address, mention.argumentNumber, addend, relocation.label});
+        }
+      }
+    }
+
+    cache.objects[replacement.index].hash = hashes[replacement.index];
+  }
+
+  cache.imports = std::move(imports);
+
+  std::sort(symbols.symbols.begin(), symbols.symbols.end(),
+    [](auto& lhs, auto& rhs) { return lhs.address < rhs.address; });
+
+  result.magic = XVM_MAGIC;
+  result.version = XVM_VERSION_CODE;
+  result.flags = pic ? (u32) ExecutableFlags::PIC : 0;
+
+  result.sections.push_back(Executable::Section(SectionType::CODE, "code", code, 0));
+
+  if (previous.hasSection("data")) {
+    result.sections.push_back(Executable::Section(SectionType::DATA, "data", data, dataBase));
+  }
+
+  if (previous.hasSection("bss")) {
+    result.sections.push_back(copySection(previous.getSection("bss")));
+  }
+
+  result.sections.push_back(symbols.toSection());
+  result.sections.push_back(RelocationTable().toSection());
+
+  ObjectTable objectTable;
+  for (const auto& object : cache.objects) {
+    objectTable.objects.push_back({object.codeOffset, object.hash});
+  }
+  result.sections.push_back(objectTable.toSection());
+
+  debug("Replaced %zu of %zu objects", changed.size(), objects.size());
+  return PatchResult::PATCHED;
+}
+
+/*
+Incremental link leaves room after every object and stores where everything
+went into FILENAME.linkcache (see LinkCache). On the next link, objects whose
+contents changed are written over their old place and mentions of symbols
+they moved are patched, everything else is taken from the previous output.
+Full link is done when there is no cache, options or the object list changed,
+an object outgrew its room or changed what it exports. Code isn't garbage
+collected or reordered by profile, since that would move other objects.
+Cache is only kept when every extern got resolved statically.
+*/
+bool xvm::linkIncremental(const std::vector<Executable>& objects, const std::string& filename) {
+  checkObjects(objects);
+
+  std::string cacheFile = filename + ".linkcache";
+  LinkCache cache;
+  Executable result;
+
+  PatchResult patched = PatchResult::FAILED;
+  if (LinkCache::fromFile(cacheFile, cache)) {
+    patched = patchOutput(objects, filename, cache, result);
+  }
+
+  if (patched == PatchResult::UP_TO_DATE) {
+    debug("'%s' is up to date", filename.c_str());
+    return true;
+  }
+
+  if (patched == PatchResult::FAILED) {
+    debug("Doing a full link");
+    cache = LinkCache();
+    result = linkObjects(objects, objectHashes(objects), &cache);
+  }
+
+  auto bytes = result.toBytes();
+
+  FILE* file = fopen(filename.c_str(), "wb");
+  if (!file) {
+    error("Failed to open/create '%s'", filename.c_str());
+    return false;
+  }
+  fwrite(bytes.data(), 1, bytes.size(), file);
+  fclose(file);
+
+  if (!RelocationTable::fromSection(result.getSection("relocations")).relocations.empty() || result.hasSection("runinfo")) {
+    remove(cacheFile.c_str());
+    return true;
+  }
+
+  cache.options = LinkCache::optionsHash();
+  cache.outputHash = crc32c(bytes.data(), bytes.size());
+  return cache.toFile(cacheFile);
+}
@@ -1,4 +1,7 @@
 #include <xvm/loader.h>
+#include <xvm/dynamic.h>
+#include <xvm/devices/ram.h>
+#include <xvm/devices/rom.h>
 #include <xvm/config.h>
 #include <xvm/utils.h>
 #include <xvm/log.h>
@@ -9,12 +12,38 @@ int xvm::load(VM& vm, Executable& exe) {
     return 1;
   }
 
+  if (exe.flags & (u32) xvm::ExecutableFlags::CHECKSUMS && xvm::config::asBool("verify-checksums")) {
+    for (const auto& section : exe.sections) {
+      if (!section.verifyChecksum()) {
+        xvm::error("Executable loading failed: Checksum mismatch in section '%s'", section.label.c_str());
+        return 1;
+      }
+    }
+  }
+
   if (!exe.hasSection("code")) {
     xvm::error("Executable loading failed: Missing code section");
     return 1;
   }
 
+  // Code and data are decompressed straight into memory below, everything
+  // else is read whole
+  for (auto& section : exe.sections) {
+    if (section.type == xvm::SectionType::CODE || section.type == xvm::SectionType::DATA) {
+      continue;
+    }
+    if (!section.inflate()) {
+      xvm::error("Executable loading failed: Corrupted section '%s'", section.label.c_str());
+      return 1;
+    }
+  }
+
   auto& code = exe.getSection("code");
+  bool inflateCode = xvm::config::asBool("rom") || xvm::config::asBool("disasm");
+  if (inflateCode && !code.inflate()) {
+    xvm::error("Executable loading failed: Corrupted code section");
+    return 1;
+  }
 
   if (xvm::config::asBool("hexdump")) {
     printf("=== Hexdump ===\n");
@@ -33,17 +62,91 @@ int xvm::load(VM& vm, Executable& exe) {
     if (xvm::config::asBool("fancy-disasm")) {
       exe.disassemble();
     } else {
-      for (int i = 0; i < code.data.size(); ) {
-        i = xvm::abi::disassembleInstruction(code.data.data(), i);
+      for (int i = 0; i < code.length(); ) {
+        i = xvm::abi::disassembleInstruction(code.bytes(), i);
+      }
+    }
+  }
+
+  auto ram = static_cast<xvm::bus::device::RAM*>(vm.getBus().getDeviceByName(XVM_BUS_DEV_RAM_NAME));
+
+  // Sections are placed at their addresses, sections without one (v1
+  // executables don't store them) right after the previous one
+  std::vector<size_t> addresses;
+  size_t imageEnd = code.length();
+
+  for (const auto& section : exe.sections) {
+    size_t addr = section.addr != -1U ? section.addr : imageEnd;
+    addresses.push_back(addr);
+    if (section.type == xvm::SectionType::DATA || section.type == xvm::SectionType::BSS) {
+      imageEnd = std::max(imageEnd, addr + section.memoryLength());
+    }
+  }
+
+  if (imageEnd > ram->getSize()) {
+    if (!vm.getBus().resize(ram, imageEnd - 1) || !ram->resize(imageEnd)) {
+      vm.getBus().resize(ram, ram->getSize() - 1);
+      xvm::error("Executable loading failed: Not enough RAM (0x%zx bytes needed)", imageEnd);
+      return 1;
+    }
+  }
+
+  if (xvm::config::asBool("rom")) {
+    // Code is shared with other VMs loading the same image instead of being
+    // copied into RAM
+    auto rom = new xvm::bus::device::ROM(code.bytes(), code.length(), 0);
+    rom->setWriteHandler([&vm](size_t) { vm.stop(); });
+    // Bus ranges include their end address
+    if (code.length() > 0) {
+      vm.getBus().overlay(0, code.length() - 1, rom, true);
+    } else {
+      delete rom;
+    }
+  } else if (code.isCompressed()) {
+    // Decompressed straight into RAM, without an intermediate buffer
+    if (!code.unpack(ram->getBuffer())) {
+      xvm::error("Executable loading failed: Corrupted code section");
+      return 1;
+    }
+  } else {
+    vm.loadRegion(0, code.bytes(), code.length());
+  }
+
+  // bss takes no space in the executable, RAM is already zero-filled and
+  // its pages are committed on first touch
+  for (size_t i = 0; i < exe.sections.size(); i++) {
+    const auto& section = exe.sections[i];
+    if (section.type != xvm::SectionType::DATA) {
+      continue;
+    }
+    if (section.isCompressed()) {
+      if (!section.unpack(ram->getBuffer() + addresses[i])) {
+        xvm::error("Executable loading failed: Corrupted section '%s'", section.label.c_str());
+        return 1;
       }
+    } else {
+      vm.loadRegion(addresses[i], section.bytes(), section.length());
     }
   }
 
-  vm.loadRegion(0, code.data.data(), code.data.size());
+  vm.getHeap().initialize(imageEnd, ram->getSize());
   
   if (exe.hasSection("symbols")) {
     vm.loadSymbols(xvm::SymbolTable::fromSection(exe.getSection("symbols")));
   }
 
+  if (exe.hasSection("objects")) {
+    vm.loadObjects(xvm::ObjectTable::fromSection(exe.getSection("objects")));
+  }
+
+  if (exe.hasSection("runinfo")) {
+    auto linker = std::make_unique<xvm::DynamicLinker>();
+    if (linker->load(vm, xvm::RunInfo::fromSection(exe.getSection("runinfo")))) {
+      xvm::error("Executable loading failed: Can't load dynamic libraries");
+      return 1;
+    }
+    vm.setDynamicLinker(std::move(linker));
+  }
+
   return 0;
 }
@@ -5,6 +5,7 @@
 #include <xvm/config.h>
 #include <xvm/loader.h>
 #include <xvm/linker.h>
+#include <xvm/archive.h>
 #include <xvm/version.h>
 #include <xvm/assembler.h>
 #include <xvm/executable.h>
@@ -29,15 +30,31 @@ static void printHelp(const char* argv0) {
   printf("  run FILE      - Runs compiled file\n");
   printf("  runsrc FILE   - Runs source file direclty (without saving binary)\n");
   printf("  dump FILE     - Dumps info about compiled file\n");
-  printf("  link FILES    - Link multiple compiled files\n");
+  printf("  link FILES    - Link multiple compiled files and archives\n");
+  printf("  ar FILES      - Packs compiled files into archive, output can be specified with -o\n");
   // TODO: dump-section disect
   printf("Options:\n");
   printf("  -s, --setopt OPTION=VALUE - Sets option\n");
   printf("  -o, --output FILE         - Sets output file\n");
   printf("  -i, --include FOLDER      - Adds include folder\n");
+  printf("  -D, --define NAME[=VALUE] - Defines NAME before assembling\n");
 }
 
-static int compile(const std::string& filename, const std::string& output, std::vector<std::string>& includes) {
+static void defineAll(xvm::Assembler& assembler, const std::vector<std::string>& defines) {
+  for (const auto& define : defines) {
+    size_t idx = define.find("=");
+    if (idx == std::string::npos) {
+      assembler.define(define, {});
+      continue;
+    }
+
+    std::string value = define.substr(idx+1);
+    xvm::TokenType type = !value.empty() && isdigit(value[0]) ? xvm::TokenType::NUMBER : xvm::TokenType::IDENTIFIER;
+    assembler.define(define.substr(0, idx), {xvm::Token(type, value, 0)});
+  }
+}
+
+static int compile(const std::string& filename, const std::string& output, std::vector<std::string>& includes, const std::vector<std::string>& defines) {
   if (!xvm::isFileExists(filename)) {
     xvm::error("File not exists: '%s'", filename.c_str());
     return 1;
@@ -48,6 +65,7 @@ static int compile(const std::string& filename, const std::string& output, std::
 
   xvm::Assembler assembler(filename, source);
   assembler.setIncludeFolders(includes);
+  defineAll(assembler, defines);
 
   xvm::Executable exe;
   if (int ret = assembler.assemble(exe, xvm::config::asBool("include-symbols"))) {
@@ -67,8 +85,8 @@ static int compile(const std::string& filename, const std::string& output, std::
     if (xvm::config::asBool("fancy-disasm")) {
       exe.disassemble();
     } else {
-      for (int i = 0; i < code.data.size(); ) {
-        i = xvm::abi::disassembleInstruction(code.data.data(), i);
+      for (int i = 0; i < code.length(); ) {
+        i = xvm::abi::disassembleInstruction(code.bytes(), i);
       }
     }
   }
@@ -90,9 +108,13 @@ static int run(const std::string& filename) {
     return 1;
   }
 
-  xvm::Executable exe = xvm::Executable::fromFile(filename);
+  // Loader decompresses code and data itself, straight into RAM
+  xvm::Executable exe = xvm::Executable::fromFile(filename, false);
 
   xvm::VM vm(xvm::config::asInt("ram-size"));
+  if (!vm.isReady()) {
+    return 1;
+  }
 
   if (xvm::load(vm, exe)) {
     return 1;
@@ -107,7 +129,7 @@ static int run(const std::string& filename) {
   return 0;
 }
 
-static int runSrc(const std::string& filename, std::vector<std::string>& includes) {
+static int runSrc(const std::string& filename, std::vector<std::string>& includes, const std::vector<std::string>& defines) {
   if (!xvm::isFileExists(filename)) {
     xvm::error("File not exists: '%s'", filename.c_str());
     return -1;
@@ -118,6 +140,7 @@ static int runSrc(const std::string& filename, std::vector<std::string>& include
 
   xvm::Assembler assembler(filename, source);
   assembler.setIncludeFolders(includes);
+  defineAll(assembler, defines);
 
   xvm::Executable exe;
   if (int ret = assembler.assemble(exe, xvm::config::asBool("include-symbols"))) {
@@ -126,6 +149,9 @@ static int runSrc(const std::string& filename, std::vector<std::string>& include
   }
 
   xvm::VM vm(xvm::config::asInt("ram-size"));
+  if (!vm.isReady()) {
+    return 1;
+  }
 
   if (xvm::load(vm, exe)) {
     return 1;
@@ -142,22 +168,64 @@ static int runSrc(const std::string& filename, std::vector<std::string>& include
 
 static int link(const std::vector<std::string>& files, const std::string& outputFile) {
   std::vector<xvm::Executable> exes;
+  std::vector<xvm::Archive> archives;
+  std::vector<std::string> objectFiles;
 
   for (const auto& file : files) {
     if (!xvm::isFileExists(file)) {
       xvm::error("File not exists: '%s'", file.c_str());
       return -1;
     }
-    exes.push_back(xvm::Executable::fromFile(file));
+
+    if (xvm::Archive::isArchive(file)) {
+      archives.push_back(xvm::Archive::fromFile(file));
+    } else {
+      objectFiles.push_back(file);
+    }
   }
 
-  auto exe = xvm::link(exes);
+  exes.resize(objectFiles.size());
+  xvm::parallelFor(objectFiles.size(), [&](size_t i) {
+    exes[i] = xvm::Executable::fromFile(objectFiles[i]);
+  }, xvm::config::asInt("link-threads"));
+
+  if (xvm::config::asBool("link-incremental")) {
+    return xvm::linkIncremental(archives.empty() ? exes : xvm::resolveArchives(exes, archives), outputFile) ? 0 : 1;
+  }
+
+  auto exe = archives.empty() ? xvm::link(exes) : xvm::link(exes, archives);
 
   exe.toFile(outputFile);
 
   return 0;
 }
 
+static int archive(const std::vector<std::string>& files, const std::string& outputFile) {
+  xvm::Archive archive;
+
+  for (const auto& file : files) {
+    if (!xvm::isFileExists(file)) {
+      xvm::error("File not exists: '%s'", file.c_str());
+      return -1;
+    }
+
+    xvm::Executable exe = xvm::Executable::fromFile(file);
+    if (exe.magic == XVM_BAD_MAGIC) {
+      xvm::error("Error opening/reading executable '%s'", file.c_str());
+      return 1;
+    }
+
+    size_t idx = file.find_last_of('/');
+    if (!archive.addMember(idx == std::string::npos ? file : file.substr(idx+1), exe)) {
+      return 1;
+    }
+  }
+
+  archive.toFile(outputFile);
+
+  return 0;
+}
+
 static int dump(const std::string& filename) {
   if (!xvm::isFileExists(filename)) {
     xvm::error("File not exists: '%s'", filename.c_str());
@@ -177,8 +245,9 @@ static int dump(const std::string& filename) {
     "File:    %s\n"
     "Magic:   0x%x\n"
     "Version: 0x%x\n"
-    "Flags:   0x%x\n",
-    filename.c_str(), exe.magic, exe.version, exe.flags
+    "Flags:   0x%x\n"
+    "Format:  v%u\n",
+    filename.c_str(), exe.magic, exe.version, exe.flags, exe.format
   );
 
   printf("\nSections:\n");
@@ -197,8 +266,8 @@ static int dump(const std::string& filename) {
       if (xvm::config::asBool("fancy-disasm")) {
         exe.disassemble();
       } else {
-        for (int i = 0; i < section.data.size(); ) {
-          i = xvm::abi::disassembleInstruction(section.data.data(), i);
+        for (int i = 0; i < section.length(); ) {
+          i = xvm::abi::disassembleInstruction(section.bytes(), i);
         }
       }
     }
@@ -222,8 +291,41 @@ static int dump(const std::string& filename) {
       xvm::printTable({"name", "address", "arg"}, lines);
     }
 
+    if (section.type == xvm::SectionType::RUNINFO) {
+      auto info = xvm::RunInfo::fromSection(section);
+
+      for (const auto& library : info.libraries) {
+        printf("Library: %s\n", library.c_str());
+      }
+
+      std::vector<std::vector<std::string>> lines;
+
+      for (const auto& import : info.imports) {
+        char stub[16];
+        snprintf(stub, sizeof(stub), "0x%x", import.stub);
+        lines.push_back({import.label, stub});
+      }
+
+      xvm::printTable({"import", "stub"}, lines);
+    }
+
+    if (section.type == xvm::SectionType::OBJECTS) {
+      auto table = xvm::ObjectTable::fromSection(section);
+
+      std::vector<std::vector<std::string>> lines;
+
+      for (const auto& object : table.objects) {
+        char begin[16], hash[16];
+        snprintf(begin, sizeof(begin), "0x%x", object.codeBegin);
+        snprintf(hash, sizeof(hash), "0x%08x", object.hash);
+        lines.push_back({begin, hash});
+      }
+
+      xvm::printTable({"code", "hash"}, lines);
+    }
+
     if (section.type == xvm::SectionType::DATA) {
-      xvm::abi::hexdump(section.data.data(), section.data.size());
+      xvm::abi::hexdump(section.bytes(), section.length());
     }
   }
 
@@ -242,6 +344,7 @@ int main(int argc, char ** argv) {
   std::string outputFilename = "out.xbin";
 
   std::vector<std::string> includeFolders;
+  std::vector<std::string> defines;
 
   for (int i = 1; i < argc; i++) {
     if (!strcmp("-s", argv[i]) || !strcmp("--setopt", argv[i])) {
@@ -265,6 +368,12 @@ int main(int argc, char ** argv) {
         return -1;
       }
       includeFolders.push_back(argv[++i]);
+    } else if (!strcmp("-D", argv[i]) || !strcmp("--define", argv[i])) {
+      if (i+1 >= argc) {
+        xvm::error("Expected 'name[=value]' after '%s'", argv[i]);
+        return -1;
+      }
+      defines.push_back(argv[++i]);
     } else {
       if (command.empty()) {
         command = argv[i];
@@ -284,15 +393,17 @@ int main(int argc, char ** argv) {
   } else if (command == "test") { // DEBUG
     test();
   } else if (command == "compile") {
-    return compile(inputFilenames[0], outputFilename, includeFolders);
+    return compile(inputFilenames[0], outputFilename, includeFolders, defines);
   } else if (command == "run") {
     return run(inputFilenames[0]);
   } else if (command == "runsrc") {
-    return runSrc(inputFilenames[0], includeFolders);
+    return runSrc(inputFilenames[0], includeFolders, defines);
   } else if (command == "dump") {
     return dump(inputFilenames[0]);
   } else if (command == "link") {
     return link(inputFilenames, outputFilename);
+  } else if (command == "ar") {
+    return archive(inputFilenames, outputFilename);
   } else {
     xvm::error("Unknown command: '%s'", command.c_str());
   }
@@ -0,0 +1,72 @@
+#include <xvm/profiler.h>
+#include <xvm/log.h>
+
+#include <cinttypes>
+#include <cstring>
+#include <cstdio>
+#include <map>
+
+void xvm::Profiler::setObjects(const ObjectTable& objects) {
+  m_objects = objects;
+}
+
+bool xvm::Profiler::write(const std::string& filename, const SymbolTable& symbols) const {
+  // Symbol address -> count, so lines come out sorted
+  std::map<i32, std::pair<u64, const SymbolTable::Symbol*>> totals;
+
+  for (size_t address = 0; address < m_counts.size(); address++) {
+    if (m_counts[address] == 0) {
+      continue;
+    }
+
+    const auto* symbol = symbols.findNearest(address);
+    auto& total = totals[symbol ? symbol->address : -1];
+    total.first += m_counts[address];
+    total.second = symbol;
+  }
+
+  FILE* file = fopen(filename.c_str(), "w");
+  if (!file) {
+    error("Failed to open/create '%s'", filename.c_str());
+    return false;
+  }
+
+  for (const auto& total : totals) {
+    const auto* symbol = total.second.second;
+    fprintf(file, "0x%x %" PRIu64 " %s 0x%x\n", symbol ? symbol->address : 0, total.second.first,
+      symbol ? symbol->label.c_str() : "?", symbol ? m_objects.findHash(symbol->address) : 0);
+  }
+
+  fclose(file);
+  return true;
+}
+
+xvm::Profiler::Profile xvm::Profiler::read(const std::string& filename) {
+  Profile profile;
+
+  FILE* file = fopen(filename.c_str(), "r");
+  if (!file) {
+    error("Failed to open '%s'", filename.c_str());
+    return profile;
+  }
+
+  char line[512];
+  char label[256];
+  unsigned address, object;
+  u64 count;
+  while (fgets(line, sizeof line, file)) {
+    // OBJECT is missing in profiles written before it was added
+    int fields = sscanf(line, "%x %" SCNu64 " %255s %x", &address, &count, label, &object);
+    if (fields < 3 || strcmp(label, "?") == 0) {
+      continue;
+    }
+
+    profile.byLabel[label] += count;
+    if (fields == 4 && object != 0) {
+      profile.byObject[{object, label}] += count;
+    }
+  }
+
+  fclose(file);
+  return profile;
+}
@@ -0,0 +1,135 @@
+#include <xvm/stack.h>
+#include <xvm/log.h>
+
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define XVM_GUARD_SIZE (64 * 1024)
+
+// Faults are only looked up in regions the faulting thread armed a handler
+// for, so there is no process wide registry to lock from the signal handler
+static thread_local xvm::GuardedRegion::FaultHandler* t_handler = nullptr;
+static thread_local xvm::GuardedRegion::Fault t_lastFault;
+
+// Handlers installed before ours, faults that aren't ours go to them
+static struct sigaction g_previousSegv;
+static struct sigaction g_previousBus;
+
+static size_t pageAlign(size_t size) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  return (size + page - 1) / page * page;
+}
+
+/*
+Guard page hits jump back into VM::run with siglongjmp, whatever was running
+at the time is left without its destructors called. That is the interpreter
+loop or a syscall it called, syscalls pop their arguments before acquiring
+anything and push results last so nothing is skipped then
+*/
+static void faultHandler(int sig, siginfo_t* info, void* context) {
+  const xvm::GuardedRegion::FaultHandler* handler = t_handler;
+  if (handler) {
+    for (size_t i = 0; i < handler->regionCount; i++) {
+      bool overflow = false;
+      if (handler->regions[i]->check(info->si_addr, overflow)) {
+        t_lastFault = {handler->regions[i], overflow};
+        siglongjmp(*handler->jump, 1);
+      }
+    }
+  }
+
+  const struct sigaction& previous = sig == SIGBUS ? g_previousBus : g_previousSegv;
+  if (previous.sa_flags & SA_SIGINFO) {
+    previous.sa_sigaction(sig, info, context);
+  } else if (previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN) {
+    previous.sa_handler(sig);
+  } else {
+    // Fault happens again once we return, handled the way it was before us
+    sigaction(sig, &previous, nullptr);
+  }
+}
+
+static void installFaultHandler() {
+  static std::once_flag installed;
+  std::call_once(installed, [] {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = faultHandler;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+
+    sigaction(SIGSEGV, &action, &g_previousSegv);
+    sigaction(SIGBUS, &action, &g_previousBus);
+  });
+}
+
+xvm::GuardedRegion::GuardedRegion(size_t size) {
+  m_size = pageAlign(size);
+  m_mappingSize = m_size + 2 * XVM_GUARD_SIZE;
+
+  void* mapping = mmap(nullptr, m_mappingSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (mapping == MAP_FAILED) {
+    error("Failed to map %zu bytes for a stack: %s", m_mappingSize, strerror(errno));
+    m_size = 0;
+    m_mappingSize = 0;
+    return;
+  }
+
+  m_mapping = static_cast<uint8_t*>(mapping);
+  if (mprotect(m_mapping + XVM_GUARD_SIZE, m_size, PROT_READ | PROT_WRITE) != 0) {
+    error("Failed to unprotect a stack: %s", strerror(errno));
+    m_size = 0;
+    return;
+  }
+  m_begin = m_mapping + XVM_GUARD_SIZE;
+
+  installFaultHandler();
+}
+
+xvm::GuardedRegion::~GuardedRegion() {
+  if (m_mapping) {
+    munmap(m_mapping, m_mappingSize);
+  }
+}
+
+bool xvm::GuardedRegion::isValid() const {
+  return m_begin != nullptr;
+}
+
+void* xvm::GuardedRegion::begin() const {
+  return m_begin;
+}
+
+size_t xvm::GuardedRegion::size() const {
+  return m_size;
+}
+
+bool xvm::GuardedRegion::check(const void* address, bool& overflow) const {
+  auto addr = static_cast<const uint8_t*>(address);
+  if (addr >= m_mapping && addr < m_begin) {
+    overflow = false;
+    return true;
+  }
+  if (addr >= m_begin + m_size && addr < m_mapping + m_mappingSize) {
+    overflow = true;
+    return true;
+  }
+  return false;
+}
+
+void xvm::GuardedRegion::armFaultHandler(FaultHandler* handler) {
+  handler->previous = t_handler;
+  t_handler = handler;
+}
+
+void xvm::GuardedRegion::disarmFaultHandler(FaultHandler* handler) {
+  t_handler = handler->previous;
+}
+
+xvm::GuardedRegion::Fault xvm::GuardedRegion::getLastFault() {
+  return t_lastFault;
+}
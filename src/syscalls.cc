@@ -24,10 +24,8 @@ int xvm::utils::getAddr(VM* vm, const std::string& str) {
   if (str.size() && isdigit(str[0])) {
     return getInt(str);
   } else {
-    if (vm->getSymbols().symbols.size()) {
-      if (vm->getSymbols().hasLabel(str)) {
-        return vm->getSymbols().getByLabel(str).address;
-      }
+    if (auto symbol = vm->getSymbols().findByLabel(str)) {
+      return symbol->address;
     }
   }
   return -1;
@@ -49,11 +47,18 @@ void xvm::registerSyscalls(VM* vm) {
   vm->registerSyscall(VMX_SYSCALL_CLOSE,      "close",      sys_close);
   vm->registerSyscall(VMX_SYSCALL_READ,       "read",       sys_read);
   vm->registerSyscall(VMX_SYSCALL_WRITE,      "write",      sys_write);
+  vm->registerSyscall(VMX_SYSCALL_MMAP,       "mmap",       sys_mmap);
+  vm->registerSyscall(VMX_SYSCALL_MUNMAP,     "munmap",     sys_munmap);
+  vm->registerSyscall(VMX_SYSCALL_MALLOC,     "malloc",     sys_malloc);
+  vm->registerSyscall(VMX_SYSCALL_FREE,       "free",       sys_free);
+  vm->registerSyscall(VMX_SYSCALL_REALLOC,    "realloc",    sys_realloc);
   vm->registerSyscall(VMX_SYSCALL_SLEEP,      "sleep",      sys_sleep);
   vm->registerSyscall(VMX_SYSCALL_FSCTL,      "fsctl",      [](VM* vm) {});
-  vm->registerSyscall(VMX_SYSCALL_VMCTL,      "vmctl",      [](VM* vm) {});
+  vm->registerSyscall(VMX_SYSCALL_VMCTL,      "vmctl",      sys_vmctl);
   vm->registerSyscall(VMX_SYSCALL_SYSCTL,     "sysctl",     [](VM* vm) {});
   vm->registerSyscall(VMX_SYSCALL_BREAKPOINT, "breakpoint", sys_breakpoint);
+  vm->registerSyscall(VMX_SYSCALL_INIT_DMA,   "init_dma",   sys_init_dma);
+  vm->registerSyscall(VMX_SYSCALL_DL_RESOLVE, "dl_resolve", sys_dl_resolve);
 #ifdef XVM_FEATURE_VIDEO
   vm->registerSyscall(VMX_SYSCALL_INIT_VIDEO, "init_video", sys_init_video);
 #endif /* XVM_FEATURE_VIDEO */
@@ -0,0 +1,20 @@
+#include <xvm/syscalls.h>
+#include <xvm/devices/dma.h>
+#include <xvm/log.h>
+
+void xvm::sys_init_dma(VM* vm) {
+  int base = vm->getStack().pop();
+
+  if (vm->getBus().getDeviceByName(XVM_BUS_DEV_DMA_NAME) != nullptr) {
+    return;
+  }
+
+  // Bus ranges include their end address
+  if (!vm->getBus().bind(base, XVM_DMA_REGISTERS_SIZE - 1, &vm->m_dma, false)) {
+    error("Can't bind dma device at 0x%x", base);
+    vm->stop();
+    return;
+  }
+
+  vm->m_dma.initialize(base);
+}
@@ -0,0 +1,14 @@
+#include <xvm/syscalls.h>
+#include <xvm/dynamic.h>
+
+void xvm::sys_dl_resolve(VM* vm) {
+  u32 index = vm->getStack().pop();
+
+  i32 address = vm->getDynamicLinker() ? vm->getDynamicLinker()->resolve(*vm, index) : -1;
+  if (address < 0) {
+    vm->stop();
+    return;
+  }
+
+  vm->jump(address);
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include <xvm/syscalls.h>
+#include <xvm/devices/ram.h>
+#include <xvm/log.h>
+
+#include <algorithm>
+#include <cstring>
+
+void xvm::sys_malloc(VM* vm) {
+  int32_t size = vm->getStack().pop();
+
+  vm->getStack().push(size > 0 ? vm->getHeap().allocate(size) : 0);
+}
+
+void xvm::sys_free(VM* vm) {
+  int32_t ptr = vm->getStack().pop();
+
+  if (ptr && !vm->getHeap().release(ptr)) {
+    error("free: 0x%x is not an allocated block", ptr);
+    vm->stop();
+  }
+}
+
+void xvm::sys_realloc(VM* vm) {
+  int32_t size = vm->getStack().pop();
+  int32_t ptr = vm->getStack().pop();
+
+  Heap& heap = vm->getHeap();
+
+  if (!ptr) {
+    vm->getStack().push(size > 0 ? heap.allocate(size) : 0);
+    return;
+  }
+
+  u32 oldSize = heap.getBlockSize(ptr);
+  if (!oldSize) {
+    error("realloc: 0x%x is not an allocated block", ptr);
+    vm->stop();
+    return;
+  }
+
+  if (size <= 0) {
+    heap.release(ptr);
+    vm->getStack().push(0);
+    return;
+  }
+
+  if ((u32) size <= oldSize) {
+    vm->getStack().push(ptr);
+    return;
+  }
+
+  u32 newPtr = heap.allocate(size);
+  if (newPtr) {
+    u8* buffer = vm->getRam().getBuffer();
+    memcpy(buffer + newPtr, buffer + ptr, std::min<u32>(oldSize, size));
+    heap.release(ptr);
+  }
+
+  vm->getStack().push(newPtr);
+}
@@ -1,4 +1,5 @@
 #include <xvm/syscalls.h>
+#include <xvm/devices/mapped_file.h>
 #include <xvm/log.h>
 
 #include <unordered_map>
@@ -116,3 +117,40 @@ void xvm::sys_write(VM* vm) {
 
   write(fd, ram->getBuffer()+buffer, len);
 }
+
+void xvm::sys_mmap(VM* vm) {
+  int32_t addr = vm->getStack().pop();
+  int32_t mode = vm->getStack().pop();
+  int32_t fileptr = vm->getStack().pop();
+
+  std::string filename = utils::busReadString(vm, fileptr);
+  bool writable = mode & (VMX_SYSCALL_FILE_MODE_WRONLY | VMX_SYSCALL_FILE_MODE_RDWR);
+
+  auto file = new bus::device::MappedFile(filename, addr, writable);
+
+  vm->getDma().wait();
+
+  // Bus ranges include their end address, empty files have no range to bind
+  if (!file->isOpen() || file->getSize() == 0 || !vm->getBus().bind(addr, file->getSize() - 1, file, true)) {
+    debug("Failed to map file '%s' at 0x%x", filename.c_str(), addr);
+    delete file;
+    vm->getStack().push(-1);
+    return;
+  }
+
+  vm->getStack().push(file->getSize());
+}
+
+void xvm::sys_munmap(VM* vm) {
+  int32_t addr = vm->getStack().pop();
+
+  auto dev = vm->getBus().getDeviceByAddress(addr);
+
+  if (!dev || dev->getName() != XVM_BUS_DEV_MAPPED_FILE_NAME) {
+    error("munmap: No mapped file at 0x%x", addr);
+    return;
+  }
+
+  vm->getDma().wait();
+  vm->getBus().unbind(dev);
+}
@@ -10,6 +10,7 @@ void xvm::sys_init_video(VM* vm) {
   int width = vm->getStack().pop();
 
   if (vm->getBus().getDeviceByName(XVM_BUS_DEV_VIDEO_NAME) == nullptr) {
+    vm->getDma().wait();
     vm->getBus().bind(memStart, memStart + 256 + height*width, &vm->m_video, false);
   }
 
@@ -0,0 +1,43 @@
+#include <xvm/syscalls.h>
+#include <xvm/devices/ram.h>
+#include <xvm/log.h>
+
+void xvm::sys_vmctl(VM* vm) {
+  int32_t cmd = vm->getStack().pop();
+
+  auto ram = static_cast<bus::device::RAM*>(vm->getBus().getDeviceByName(XVM_BUS_DEV_RAM_NAME));
+
+  switch (cmd) {
+    case VMX_SYSCALL_VM_GET_RAM: {
+      vm->getStack().push(ram->getSize());
+      break;
+    }
+    case VMX_SYSCALL_VM_EXPAND_RAM: {
+      int32_t bytes = vm->getStack().pop();
+      size_t size = ram->getSize() + bytes;
+
+      vm->getDma().wait();
+
+      // Bus ranges include their end address
+      if (bytes < 0 || !vm->getBus().resize(ram, size - 1)) {
+        vm->getStack().push(0);
+        break;
+      }
+
+      if (!ram->resize(size)) {
+        vm->getBus().resize(ram, ram->getSize() - 1);
+        vm->getStack().push(0);
+        break;
+      }
+
+      vm->getHeap().extend(size);
+      vm->getStack().push(size);
+      break;
+    }
+    default: {
+      error("vmctl: Unknown command %d", cmd);
+      vm->stop();
+      break;
+    }
+  }
+}
@@ -2,6 +2,8 @@
 
 #include <iostream>
 #include <sstream>
+#include <atomic>
+#include <thread>
 #include <sys/stat.h>
 
 bool xvm::isFileExists(const std::string& name) {
@@ -72,3 +74,34 @@ void xvm::printTable(const std::vector<std::string>& fields, std::vector<std::ve
 [[noreturn]] void xvm::die(int returnCode) {
   exit(returnCode);
 }
+
+void xvm::parallelFor(size_t count, const std::function<void(size_t)>& fn, size_t threads) {
+  if (threads == 0) {
+    threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  threads = std::min(threads, count);
+
+  if (threads <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      fn(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next {0};
+  auto worker = [&next, &fn, count] {
+    for (size_t i = next++; i < count; i = next++) {
+      fn(i);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (size_t i = 1; i < threads; i++) {
+    pool.emplace_back(worker);
+  }
+  worker();
+
+  for (auto& thread : pool) {
+    thread.join();
+  }
+}
@@ -5,14 +5,37 @@
 #include <xvm/syscalls.h>
 #include <xvm/devices/ram.h>
 
-xvm::VM::VM(size_t ramSize) : m_ram(ramSize, 0) {
-  m_bus.bind(0, ramSize, &m_ram, false);
+#include <cstring>
+
+xvm::VM::VM(size_t ramSize)
+  : m_ram(ramSize, 0, config::asInt("ram-max-size"), config::asBool("ram-hugepages")), m_dma(&m_bus), m_stack(config::asInt("stack-size")), m_callStack(config::asInt("call-stack-size")) {
+  // Bus ranges include their end address
+  m_bus.bind(0, ramSize - 1, &m_ram, false);
   registerSyscalls(this);
+
+  if (!config::get("profile").empty()) {
+    m_profiler = std::make_unique<Profiler>();
+  }
 }
 
 xvm::VM::~VM() {}
 
+bool xvm::VM::isReady() const {
+  return m_ram.isValid() && m_stack.getRegion().isValid() && m_callStack.getRegion().isValid();
+}
+
 void xvm::VM::loadRegion(size_t address, const uint8_t* data, size_t length) {
+  if (length == 0) {
+    return;
+  }
+
+  // Fast path for regions fully backed by RAM
+  if (m_bus.getDeviceByAddress(address) == &m_ram && m_bus.getDeviceByAddress(address+length-1) == &m_ram
+      && address+length <= m_ram.getSize()) {
+    memcpy(m_ram.getBuffer() + address, data, length);
+    return;
+  }
+
   for (size_t i = 0; i < length; i++) {
     m_bus.write(address+i, data[i]);
   }
@@ -58,6 +81,13 @@ void xvm::VM::loadSymbols(const SymbolTable& table) {
   m_symbols = table;
 }
 
+// Only the profile needs to know which object code came from
+void xvm::VM::loadObjects(const ObjectTable& table) {
+  if (m_profiler) {
+    m_profiler->setObjects(table);
+  }
+}
+
 xvm::bus::Bus& xvm::VM::getBus() {
   return m_bus;
 }
@@ -70,6 +100,26 @@ xvm::SymbolTable& xvm::VM::getSymbols() {
   return m_symbols;
 }
 
+xvm::DynamicLinker* xvm::VM::getDynamicLinker() {
+  return m_dynamicLinker.get();
+}
+
+void xvm::VM::setDynamicLinker(std::unique_ptr<DynamicLinker> linker) {
+  m_dynamicLinker = std::move(linker);
+}
+
+xvm::bus::device::RAM& xvm::VM::getRam() {
+  return m_ram;
+}
+
+xvm::Heap& xvm::VM::getHeap() {
+  return m_heap;
+}
+
+xvm::bus::device::DMA& xvm::VM::getDma() {
+  return m_dma;
+}
+
 void xvm::VM::jump(int32_t address) {
   m_ip = address;
 }
@@ -112,23 +162,58 @@ void xvm::VM::reset() {
   m_stack.reset();
   m_callStack.reset();
   m_ip = 0;
+  m_fp = 0;
 }
 
 void xvm::VM::run() {
   using namespace abi;
 
+  // Armed before sigsetjmp so nothing it reads after a jump changes in between
+  sigjmp_buf faultJump;
+  const GuardedRegion* regions[] {&m_stack.getRegion(), &m_callStack.getRegion()};
+  GuardedRegion::FaultHandler faultHandler;
+  faultHandler.jump = &faultJump;
+  faultHandler.regions = regions;
+  faultHandler.regionCount = 2;
+  GuardedRegion::armFaultHandler(&faultHandler);
+
+  if (sigsetjmp(faultJump, 1)) {
+    GuardedRegion::disarmFaultHandler(&faultHandler);
+    auto fault = GuardedRegion::getLastFault();
+    error("%s %s at 0x%zx",
+      fault.region == &m_callStack.getRegion() ? "Call stack" : "Stack",
+      fault.overflow ? "overflow" : "underflow", m_ip);
+    m_running = false;
+    saveProfile();
+    return;
+  }
+
   m_running = true;
 
   while (m_running && m_ip < m_bus.max()) {
+    if (m_profiler) {
+      m_profiler->hit(m_ip);
+    }
+
     uint8_t flags = next();
     uint8_t opcode = next();
 
-    if (config::asInt("debug") > 0) {
+    // Dynamic library code isn't in RAM
+    if (config::asInt("debug") > 0 && m_ip-2 < m_ram.getSize()) {
       disassembleInstruction(m_ram.getBuffer(), m_ip-2);
     }
 
     AddressingMode mode[2] {extractModeArg1(flags), extractModeArg2(flags)};
-    m_running = executeInstruction(mode, (OpCode) opcode);
+    m_running = executeInstruction(mode, (OpCode) opcode) && m_running;
+  }
+
+  GuardedRegion::disarmFaultHandler(&faultHandler);
+  saveProfile();
+}
+
+void xvm::VM::saveProfile() {
+  if (m_profiler) {
+    m_profiler->write(config::get("profile"), m_symbols);
   }
 }
 
@@ -393,6 +478,12 @@ bool xvm::VM::executeInstruction(const abi::AddressingMode mode[2], const abi::O
       jump(addr._i32);
       break;
     }
+    case TAILCALL: { // Reuses caller's return address
+      N32 addr;
+      readAddr(addr, mode[0]);
+      jump(addr._i32);
+      break;
+    }
     case SYSCALL: {
       N32 number;
       if (mode[0] == IMM) {
@@ -411,6 +502,72 @@ bool xvm::VM::executeInstruction(const abi::AddressingMode mode[2], const abi::O
       jump(popCall());
       break;
     }
+    case ENTER: { // [args..] -> [args.., locals..], fp = &args[0]
+      N32 args, locals;
+      nextInt32(args);
+      nextInt32(locals);
+      if (args._i32 < 0 || (size_t) args._i32 > m_stack.size() ||
+          locals._i32 < 0 || m_stack.size() + locals._i32 > m_stack.capacity()) {
+        error("enter: %d args, %d locals out of stack range at 0x%zx", args._i32, locals._i32, m_ip);
+        return false;
+      }
+      pushCall(m_fp);
+      m_fp = m_stack.size() - args._i32;
+      for (int i = 0; i < locals._i32; i++) {
+        m_stack.push(0);
+      }
+      break;
+    }
+    case LEAVE: { // [args.., locals.., ..., results] -> [results]
+      N32 count;
+      if (mode[0] == IMM) {
+        nextInt32(count);
+      } else {
+        count._i32 = 0;
+      }
+      if (m_fp > m_stack.size() || count._i32 < 0 || (size_t) count._i32 > m_stack.size() - m_fp) {
+        error("leave: %d results out of frame range at 0x%zx", count._i32, m_ip);
+        return false;
+      }
+      size_t results = m_stack.size() - count._i32;
+      for (int i = 0; i < count._i32; i++) {
+        m_stack.set(m_fp + i, m_stack.get(results + i));
+      }
+      m_stack.resize(m_fp + count._i32);
+      m_fp = popCall();
+      break;
+    }
+    case LOADL: {
+      N32 slot;
+      nextInt32(slot);
+      if (slot._i32 < 0 || m_fp + slot._i32 >= m_stack.size()) {
+        error("loadl: Frame slot %d out of range at 0x%zx", slot._i32, m_ip);
+        return false;
+      }
+      m_stack.push(m_stack.get(m_fp + slot._i32));
+      break;
+    }
+    case STOREL: {
+      N32 slot;
+      nextInt32(slot);
+      StackType value = m_stack.pop();
+      if (slot._i32 < 0 || m_fp + slot._i32 >= m_stack.size()) {
+        error("storel: Frame slot %d out of range at 0x%zx", slot._i32, m_ip);
+        return false;
+      }
+      m_stack.set(m_fp + slot._i32, value);
+      break;
+    }
+    case PICK: {
+      N32 distance;
+      nextInt32(distance);
+      if (distance._i32 < 0 || (size_t) distance._i32 >= m_stack.size()) {
+        error("pick: Distance %d out of stack range at 0x%zx", distance._i32, m_ip);
+        return false;
+      }
+      m_stack.push(m_stack.peek(distance._i32));
+      break;
+    }
     default: {
       error("Unknown Instruction '0x%x' (flags: %s %s)", opcode,
         addressingModeToString(mode[0]).c_str(),